@@ -13,8 +13,6 @@
 bool chansend(hchan *c, void *elem, bool block);
 bool chanrecv(hchan *c, void *elem, bool block);
 
-#define chan_copy(c, dst, src) fast_copy((dst), (src), (c)->elemsize)
-
 void chan_lock(hchan *c)
 {
     if (!c)
@@ -123,7 +121,7 @@ bool chansend(hchan *c, void *elem, bool block)
         chan_copy(c, sg->elem, elem);
         sg->success = true;
         chan_unlock(c);
-        goready(gp);
+        goready_next(gp);
         return true;
     }
 
@@ -227,7 +225,7 @@ static bool chanrecv_internal(hchan *c, void *elem, bool block, bool *received)
 
         sg->success = true;
         chan_unlock(c);
-        goready(gp);
+        goready_next(gp);
 
         if (received)
             *received = true;
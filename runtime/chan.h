@@ -3,6 +3,8 @@
 #define GODC_CHAN_H
 
 #include "goroutine.h"
+#include "gc_semispace.h"
+#include "copy.h"
 
 struct __go_type_descriptor;
 struct sudog;
@@ -52,6 +54,14 @@ static inline void *chanbuf(hchan *c, uint32_t i)
     return (void *)((uintptr_t)c->buf + (uintptr_t)index * c->elemsize);
 }
 
+/* Copy one element. The destination may be a buffer slot or receiver
+ * variable in the old generation, so apply the write barrier. */
+static inline void chan_copy(hchan *c, void *dst, const void *src)
+{
+    fast_copy(dst, src, c->elemsize);
+    gc_write_barrier_range(dst, c->elemsize);
+}
+
 void chan_lock(hchan *c);
 void chan_unlock(hchan *c);
 
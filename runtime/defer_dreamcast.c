@@ -48,10 +48,12 @@ static inline void set_in_panic(bool val)
 #define g_defer_depth (must_getg()->defer_depth)
 
 /* Type descriptors */
-static const uint8_t __gccgo_defer_gcdata[] = {0x2F};
+static const uint8_t __gccgo_defer_gcdata[] = {GCCGO_DEFER_GC_PTRMAP};
+static const uint8_t __panic_record_gcdata[] = {PANIC_RECORD_GC_PTRMAP};
+static const uint8_t __checkpoint_gcdata[] = {CHECKPOINT_GC_PTRMAP};
 DEFINE_GO_TYPE_DESC(__gccgo_defer_type, GccgoDefer, GO_STRUCT, 24, __gccgo_defer_gcdata);
-DEFINE_GO_TYPE_DESC(__panic_record_type, PanicRecord, GO_STRUCT, 12, NULL);
-DEFINE_GO_TYPE_DESC(__checkpoint_type, Checkpoint, GO_STRUCT, 4, NULL);
+DEFINE_GO_TYPE_DESC(__panic_record_type, PanicRecord, GO_STRUCT, 12, __panic_record_gcdata);
+DEFINE_GO_TYPE_DESC(__checkpoint_type, Checkpoint, GO_STRUCT, 4, __checkpoint_gcdata);
 DEFINE_GO_TYPE_DESC(__gostring_header_type, GoString, GO_STRING, sizeof(void *), NULL);
 
 static inline bool in_irq_context(void)
@@ -0,0 +1,198 @@
+/* libgodc/runtime/gc_arena.c - Frame arenas
+ *
+ * Per-frame scratch data (vertex lists, sort keys, formatted strings) is
+ * dead by the end of the frame but still fills the nursery and gets copied
+ * by whatever collection happens to run while it is live. An arena is a
+ * bump region of KOS malloc memory outside the heap:
+ *
+ *   a := runtime.NewArena(64 << 10)
+ *   for {
+ *       prev := runtime.SetArena(a)  // this goroutine allocates from a
+ *       buildFrame()
+ *       runtime.SetArena(prev)
+ *       submitFrame()
+ *       runtime.ResetArena(a)        // O(1): everything in a is gone
+ *   }
+ *
+ * The arena set is the goroutine's own (G.arena), so goroutines can use
+ * different arenas, or none, at the same time. While a goroutine has an
+ * arena set, every allocation it makes, including the runtime's own
+ * (append, map growth, string concatenation), comes from the arena until
+ * the arena is full, then from the heap. Nothing may hold an arena
+ * pointer past ResetArena; the collector ignores such pointers, but the
+ * memory is reused.
+ *
+ * Arena objects carry the normal header and never move. The collector
+ * treats every live arena as a root region: each object is scanned by its
+ * header, so arena objects may point into the heap. A full collection
+ * scans all of them. A minor one scans only the objects allocated since
+ * the last collection (above arena->scanned); the write barrier remembers
+ * the older slots that receive nursery pointers, as for the semispace.
+ */
+
+#include "gc_semispace.h"
+#include "goroutine.h"
+#include "runtime.h"
+#include <string.h>
+#include <stdlib.h>
+#include <malloc.h>
+
+static gc_arena_t *arena_table[GC_MAX_ARENAS];
+
+uintptr_t gc_arena_lo;
+uintptr_t gc_arena_hi;
+
+void *gc_arena_alloc(gc_arena_t *arena, size_t size, struct __go_type_descriptor *type,
+                     bool noscan, bool needzero)
+{
+    size_t total_size = GC_HEADER_SIZE + ((size + GC_ALIGN_MASK) & ~(size_t)GC_ALIGN_MASK);
+    if ((size_t)(arena->limit - arena->ptr) < total_size)
+        return NULL;
+
+    gc_header_t *header = (gc_header_t *)arena->ptr;
+    arena->ptr += total_size;
+
+    uint8_t type_tag = type ? (type->__code & GC_KIND_MASK) : 0;
+    GC_HEADER_SET(header, type_tag, total_size);
+    header->type = type;
+    if (noscan)
+        GC_HEADER_SET_NOSCAN(header);
+
+    void *user_ptr = gc_get_user_ptr(header);
+    if (needzero)
+        memset(user_ptr, 0, total_size - GC_HEADER_SIZE);
+    return user_ptr;
+}
+
+void gc_arena_scan(void (*scan)(void *obj), bool minor)
+{
+    for (int i = 0; i < GC_MAX_ARENAS; i++)
+    {
+        gc_arena_t *arena = arena_table[i];
+        if (arena == NULL)
+            continue;
+
+        for (uint8_t *p = minor ? arena->scanned : arena->base; p < arena->ptr;)
+        {
+            gc_header_t *header = (gc_header_t *)p;
+            if (!GC_HEADER_IS_NOSCAN(header))
+                scan(gc_get_user_ptr(header));
+            p += GC_HEADER_GET_SIZE(header);
+        }
+    }
+}
+
+void gc_arena_collected(void)
+{
+    for (int i = 0; i < GC_MAX_ARENAS; i++)
+    {
+        if (arena_table[i] != NULL)
+            arena_table[i]->scanned = arena_table[i]->ptr;
+    }
+}
+
+/* For remembered set entries, which may outlive a reset or freed arena */
+bool gc_arena_contains(uintptr_t addr)
+{
+    if (!gc_maybe_arena(addr))
+        return false;
+
+    for (int i = 0; i < GC_MAX_ARENAS; i++)
+    {
+        gc_arena_t *arena = arena_table[i];
+        if (arena != NULL && addr - (uintptr_t)arena->base <
+                                 (uintptr_t)(arena->ptr - arena->base))
+            return true;
+    }
+    return false;
+}
+
+/* runtime.NewArena - reserve size bytes of arena space */
+gc_arena_t *runtime_NewArena(intptr_t size) __asm__("_runtime.NewArena");
+gc_arena_t *runtime_NewArena(intptr_t size)
+{
+    if (size <= 0)
+        runtime_panicstring("NewArena: size must be positive");
+
+    int slot = 0;
+    while (slot < GC_MAX_ARENAS && arena_table[slot] != NULL)
+        slot++;
+    if (slot == GC_MAX_ARENAS)
+        runtime_panicstring("NewArena: too many arenas (GC_MAX_ARENAS)");
+
+    gc_arena_t *arena = malloc(sizeof(gc_arena_t));
+    uint8_t *base = memalign(32, (size_t)size);
+    if (arena == NULL || base == NULL)
+    {
+        free(arena);
+        free(base);
+        runtime_panicstring("NewArena: out of memory");
+    }
+
+    arena->base = base;
+    arena->ptr = base;
+    arena->limit = base + ((size_t)size & ~(size_t)GC_ALIGN_MASK);
+    arena->scanned = base;
+    arena_table[slot] = arena;
+
+    /* Bounds for the write barrier; they only ever widen */
+    if (gc_arena_hi == 0 || (uintptr_t)base < gc_arena_lo)
+        gc_arena_lo = (uintptr_t)base;
+    if ((uintptr_t)arena->limit > gc_arena_hi)
+        gc_arena_hi = (uintptr_t)arena->limit;
+    return arena;
+}
+
+/* runtime.SetArena - route this goroutine's allocations to a (nil for the
+ * heap). Returns the previous arena, to restore when the scope ends.
+ * Other goroutines are unaffected. */
+gc_arena_t *runtime_SetArena(gc_arena_t *a) __asm__("_runtime.SetArena");
+gc_arena_t *runtime_SetArena(gc_arena_t *a)
+{
+    G *gp = current_g;
+    if (gp == NULL)
+        runtime_panicstring("SetArena: no current goroutine");
+
+    gc_arena_t *old = gp->arena;
+    gp->arena = a;
+    return old;
+}
+
+/* runtime.ResetArena - free everything allocated from a at once */
+void runtime_ResetArena(gc_arena_t *a) __asm__("_runtime.ResetArena");
+void runtime_ResetArena(gc_arena_t *a)
+{
+    if (a == NULL)
+        runtime_panicstring("ResetArena: nil arena");
+    a->ptr = a->base;
+    a->scanned = a->base;
+}
+
+/* runtime.FreeArena - return a's memory to KOS */
+void runtime_FreeArena(gc_arena_t *a) __asm__("_runtime.FreeArena");
+void runtime_FreeArena(gc_arena_t *a)
+{
+    if (a == NULL)
+        return;
+    for (int i = 0; i < allgs_get_count(); i++)
+    {
+        G *gp = allgs_iterate(i);
+        if (gp != NULL && gp->atomicstatus != Gdead && gp->arena == a)
+            runtime_panicstring("FreeArena: arena is in use");
+    }
+
+    for (int i = 0; i < GC_MAX_ARENAS; i++)
+    {
+        if (arena_table[i] == a)
+            arena_table[i] = NULL;
+    }
+    free(a->base);
+    free(a);
+}
+
+/* runtime.ArenaUsed - bytes allocated from a since its last reset */
+intptr_t runtime_ArenaUsed(gc_arena_t *a) __asm__("_runtime.ArenaUsed");
+intptr_t runtime_ArenaUsed(gc_arena_t *a)
+{
+    return a ? (intptr_t)(a->ptr - a->base) : 0;
+}
@@ -3,7 +3,9 @@
 #include "goroutine.h"
 #include "runtime.h"
 #include <string.h>
+#include <stdlib.h>
 #include <arch/cache.h>
+#include <arch/irq.h>
 #include <arch/timer.h>
 #include "dc_platform.h"
 
@@ -86,6 +88,36 @@ static void gc_sq_copy(void *dst, const void *src, size_t size)
     __asm__ volatile("" : : : "memory");
 }
 
+/* Zero 32-byte-aligned memory through the store queues. The target must
+ * not be in the cache (a cached line would later overwrite the zeros). */
+static void gc_sq_clear(void *dst, size_t size)
+{
+    uint32_t dst_addr = (uint32_t)(uintptr_t)dst;
+
+    volatile uint32_t *QACR0 = (volatile uint32_t *)0xFF000038;
+    volatile uint32_t *QACR1 = (volatile uint32_t *)0xFF00003C;
+    *QACR0 = (dst_addr >> 26) & 0x1C;
+    *QACR1 = (dst_addr >> 26) & 0x1C;
+
+    uint32_t *sq = (uint32_t *)(SQ_BASE | (dst_addr & 0x03FFFFE0));
+
+    for (size_t blocks = size / 32; blocks > 0; blocks--)
+    {
+        sq[0] = 0;
+        sq[1] = 0;
+        sq[2] = 0;
+        sq[3] = 0;
+        sq[4] = 0;
+        sq[5] = 0;
+        sq[6] = 0;
+        sq[7] = 0;
+        __asm__ volatile("pref @%0" : : "r"(sq));
+        sq = (uint32_t *)((uintptr_t)sq + 32);
+    }
+
+    __asm__ volatile("" : : : "memory");
+}
+
 static void *gc_saved_stack_lo;
 static void *gc_saved_stack_hi;
 static bool gc_stack_bounds_valid;
@@ -108,13 +140,265 @@ static void save_stack_bounds(void)
 }
 
 static void *gc_copy_object(void *ptr);
+static void gc_update_pointer_field(void **field);
 static void gc_scan_object(void *obj);
 static void gc_scan_roots(void);
 static void gc_scan_stack(void);
 static inline bool gc_validate_header(gc_header_t *header);
-static bool gc_is_valid_object_start(void *ptr);
 void gc_scan_range_conservative(void *start, size_t size);
 
+/* Set while a minor GC scans the roots: arenas are scanned from their
+ * last-collection mark only (gc_arena_scan) */
+static bool gc_minor_roots;
+
+#if GC_MARK_COMPACT
+/* What gc_update_pointer_field does with a from-space pointer */
+typedef enum
+{
+    GC_COMPACT_OFF,    /* Copy (minor GC promotion) */
+    GC_COMPACT_MARK,   /* Mark the referent */
+    GC_COMPACT_UPDATE, /* Rewrite to the referent's post-compaction address */
+} gc_compact_phase_t;
+
+static gc_compact_phase_t gc_compact_phase;
+static void gc_compact(void);
+static void gc_compact_pointer_field(void **field, gc_header_t *header);
+#endif
+
+/* Heap bounds - cached for inner loop (avoid repeated gc_heap access) */
+typedef struct
+{
+    uintptr_t lo; /* Lowest valid heap address */
+    uintptr_t hi; /* One past highest valid heap address */
+} heap_bounds_t;
+
+/*
+ * Address ranges being evacuated ("from-space").
+ *
+ * A minor GC evacuates the used part of the nursery only. A full GC also
+ * evacuates the old semispace. gc_from_hull covers every range and is the
+ * cheap first filter for conservative scanning.
+ */
+static heap_bounds_t gc_from_range[3];
+static int gc_from_count;
+static heap_bounds_t gc_from_hull;
+
+static void gc_add_from_range(uintptr_t lo, uintptr_t hi)
+{
+    gc_from_range[gc_from_count].lo = lo;
+    gc_from_range[gc_from_count].hi = hi;
+    gc_from_count++;
+    if (lo < gc_from_hull.lo)
+        gc_from_hull.lo = lo;
+    if (hi > gc_from_hull.hi)
+        gc_from_hull.hi = hi;
+}
+
+/* Conservative scanning must also see pointers to pinned and mature
+ * objects */
+static void gc_widen_hull_for_nonmoving(void)
+{
+    if (gc_pinned_hi)
+    {
+        if (gc_pinned_lo < gc_from_hull.lo)
+            gc_from_hull.lo = gc_pinned_lo;
+        if (gc_pinned_hi > gc_from_hull.hi)
+            gc_from_hull.hi = gc_pinned_hi;
+    }
+    if (gc_mature_size)
+    {
+        uintptr_t lo = (uintptr_t)gc_mature_base;
+        if (lo < gc_from_hull.lo)
+            gc_from_hull.lo = lo;
+        if (lo + gc_mature_size > gc_from_hull.hi)
+            gc_from_hull.hi = lo + gc_mature_size;
+    }
+}
+
+static void gc_set_from_ranges(uint8_t *old_space)
+{
+    gc_from_range[0].lo = (uintptr_t)gc_heap.nursery;
+    gc_from_range[0].hi = (uintptr_t)gc_heap.nursery_ptr;
+    gc_from_count = 1;
+    gc_from_hull = gc_from_range[0];
+
+    if (old_space)
+        gc_add_from_range((uintptr_t)old_space,
+                          (uintptr_t)(old_space + gc_heap.space_size));
+
+    gc_widen_hull_for_nonmoving();
+}
+
+/* Return the end of the from-space range containing addr, or 0. */
+static inline uintptr_t gc_from_range_end(uintptr_t addr)
+{
+    for (int i = 0; i < gc_from_count; i++)
+    {
+        if (addr - gc_from_range[i].lo < gc_from_range[i].hi - gc_from_range[i].lo)
+            return gc_from_range[i].hi;
+    }
+    return 0;
+}
+
+static inline bool gc_in_from_space(uintptr_t addr)
+{
+    return gc_from_range_end(addr) != 0;
+}
+
+/* Objects scanned between deadline checks in an incremental step */
+#define GC_STEP_CHECK_INTERVAL 32
+
+/*
+ * Depth-first copy order. Cheney's scan is breadth-first: an object's
+ * children are copied when the scan reaches it, after everything copied
+ * before it, so parents and children end up far apart in to-space. With
+ * gc_heap.depth_first, gc_copy_object() also pushes each copy here and the
+ * scan pops the newest first, so a child's own children are copied right
+ * behind it. When the stack is full, objects simply wait for scan_ptr.
+ *
+ * Popped objects are scanned again when scan_ptr passes them. That second
+ * scan finds every field already forwarded, so it copies nothing.
+ */
+static void *gc_dfs_stack[GC_DFS_STACK_ENTRIES];
+static int gc_dfs_count;
+
+/*
+ * Cheney's scan: process grey objects between scan_ptr and alloc_ptr.
+ * With a non-zero deadline, stop once it has passed. Returns true when
+ * the grey region is empty.
+ */
+static bool gc_scan_to_space(uint64_t deadline)
+{
+    int since_check = 0;
+
+    while (gc_heap.scan_ptr < gc_heap.alloc_ptr)
+    {
+        if (gc_dfs_count > 0)
+        {
+            gc_scan_object(gc_dfs_stack[--gc_dfs_count]);
+        }
+        else
+        {
+            gc_header_t *header = (gc_header_t *)gc_heap.scan_ptr;
+            size_t obj_size = GC_HEADER_GET_SIZE(header);
+
+            if (unlikely(obj_size < GC_HEADER_SIZE) ||
+                unlikely(obj_size > gc_heap.space_size) ||
+                unlikely(obj_size & GC_ALIGN_MASK))
+            {
+                gc_heap.scan_ptr = gc_heap.alloc_ptr;
+                break;
+            }
+
+            uint8_t *next_obj = gc_heap.scan_ptr + obj_size;
+            if (next_obj < gc_heap.alloc_ptr)
+                GC_PREFETCH(next_obj);
+
+            void *obj = gc_get_user_ptr(header);
+            gc_scan_object(obj);
+            gc_heap.scan_ptr += obj_size;
+        }
+
+        if (deadline && ++since_check == GC_STEP_CHECK_INTERVAL)
+        {
+            since_check = 0;
+            if (timer_us_gettime64() >= deadline)
+                break;
+        }
+    }
+
+    /* Everything on the stack is behind scan_ptr now */
+    if (gc_heap.scan_ptr >= gc_heap.alloc_ptr)
+    {
+        gc_dfs_count = 0;
+        return true;
+    }
+    return false;
+}
+
+/* Scan until neither to-space nor the non-moving objects have grey work */
+static void gc_drain(void)
+{
+    void *obj;
+
+    do
+    {
+        gc_scan_to_space(0);
+        while ((obj = gc_pinned_pop_grey()) != NULL)
+            gc_scan_object(obj);
+        while ((obj = gc_mature_pop_grey()) != NULL)
+            gc_scan_object(obj);
+    } while (gc_heap.scan_ptr < gc_heap.alloc_ptr);
+}
+
+/* Trace record of the pause in progress (NULL during steps) */
+static gc_trace_record_t *gc_trace_rec;
+static uint32_t gc_trace_objects;
+static uint32_t gc_trace_bytes;
+
+static void gc_trace_start(gc_trace_kind_t kind, uint64_t start_time)
+{
+    gc_trace_rec = gc_trace_begin(kind, start_time);
+
+    /* A finish reports the copying of the whole cycle */
+    if (kind != GC_TRACE_CYCLE_FINISH)
+    {
+        gc_trace_objects = 0;
+        gc_trace_bytes = 0;
+    }
+}
+
+static void gc_trace_stop(uint64_t elapsed)
+{
+    gc_trace_rec->objects_copied = gc_trace_objects;
+    gc_trace_rec->bytes_copied = gc_trace_bytes;
+    gc_trace_end(gc_trace_rec, elapsed);
+    gc_trace_rec = NULL;
+}
+
+/* Charge the time since *clock to a phase of the current record */
+static inline void gc_trace_phase(gc_phase_t phase, uint64_t *clock)
+{
+    uint64_t now = timer_us_gettime64();
+    if (gc_trace_rec)
+        gc_trace_rec->phase_us[phase] += (uint32_t)(now - *clock);
+    *clock = now;
+}
+
+/* Set while replicating from the roots at the start of an incremental
+ * cycle: referents are copied but root slots are left alone. */
+static bool gc_roots_readonly;
+
+/* Between an incremental cycle's start and its finish: the mutator still
+ * uses the originals, so small-object slots (which hold their own
+ * forwarding pointer) are left for the finish to copy. */
+static bool gc_replicating;
+
+/* Set during a heap walk (gc_walk_roots, gc_walk_object): every pointer
+ * field the scanners find is handed to it, and nothing is copied. */
+static void (*gc_walk_visit)(void **field);
+
+/* Set while gc_scan_range_conservative() runs: its words may be integers
+ * that happen to point into a space, so the header they resolve to is
+ * validated before anything is copied. */
+static bool gc_conservative;
+
+/* Empty the nursery and forget old-to-young pointers */
+static void gc_reset_nursery(void)
+{
+    if (gc_heap.nursery_clean_from < gc_heap.nursery_ptr)
+        gc_heap.nursery_clean_from = gc_heap.nursery_ptr;
+    gc_start_map_clear(gc_heap.nursery_start_map, gc_heap.nursery,
+                       gc_heap.nursery, gc_heap.nursery_ptr);
+    gc_heap.nursery_ptr = gc_heap.nursery;
+    for (int i = 0; i < GC_SMALL_CLASSES; i++)
+        gc_heap.small_page[i] = NULL;
+    gc_heap.small_pages = 0;
+    gc_remset.count = 0;
+    gc_remset.overflow = false;
+    gc_arena_collected();
+}
+
 void gc_collect(void)
 {
     if (!gc_heap.initialized)
@@ -126,61 +410,520 @@ void gc_collect(void)
     if (gc_heap.gc_in_progress)
         return;
 
+    if (gc_heap.cycle_active)
+    {
+        gc_collect_finish();
+        return;
+    }
+
     save_stack_bounds();
 
     uint64_t start_time = timer_us_gettime64();
+    gc_trace_start(GC_TRACE_FULL, start_time);
 
     gc_heap.gc_in_progress = true;
     gc_heap.gc_count++;
+    gc_pool_rotate();
 
     GODC_RUNTIME_ASSERT(gc_heap.active_space < 2, "active_space corrupt");
     GODC_RUNTIME_ASSERT(gc_heap.alloc_ptr >= gc_heap.space[gc_heap.active_space], "alloc_ptr corrupt");
     GODC_RUNTIME_ASSERT(gc_heap.alloc_ptr <= gc_heap.alloc_limit, "alloc_ptr overflow");
 
+#if GC_MARK_COMPACT
+    gc_compact();
+#else
     int old_space = gc_heap.active_space;
     int new_space = 1 - old_space;
+    uint8_t *old_end = gc_heap.alloc_ptr;
+
+    /* Full GC evacuates the nursery along with the old semispace */
+    gc_set_from_ranges(gc_heap.space[old_space]);
 
     gc_heap.active_space = new_space;
     gc_heap.alloc_ptr = gc_heap.space[new_space];
     gc_heap.alloc_limit = gc_heap.space[new_space] + gc_heap.space_size;
     gc_heap.scan_ptr = gc_heap.space[new_space];
 
+    gc_pinned_begin_mark();
+    gc_mature_begin_mark();
     gc_scan_roots();
+    gc_drain();
+    gc_pinned_sweep();
+    gc_mature_sweep();
 
-    /* Cheney's scan */
-    while (gc_heap.scan_ptr < gc_heap.alloc_ptr)
+    size_t after_size = gc_heap.alloc_ptr - gc_heap.space[gc_heap.active_space];
+    gc_heap.bytes_copied = after_size;
+    gc_heap.bytes_allocated = after_size;
+    gc_reset_nursery();
+    gc_start_map_clear(gc_heap.start_map[old_space], gc_heap.space[old_space],
+                       gc_heap.space[old_space], old_end);
+    if (gc_heap.clean_from[old_space] < old_end)
+        gc_heap.clean_from[old_space] = old_end;
+
+    /* Defer cache invalidation */
+    gc_heap.pending_invalidate_space = gc_heap.space[old_space];
+    gc_heap.invalidate_offset = 0;
+#endif
+
+    uint64_t elapsed = timer_us_gettime64() - start_time;
+    gc_trace_stop(elapsed);
+    gc_heap.last_pause_us = elapsed;
+    gc_heap.total_pause_us += elapsed;
+    gc_pacer_collected(GC_TRACE_FULL);
+    gc_pretenure_collected();
+
+    gc_heap.gc_in_progress = false;
+    gc_stack_bounds_valid = false;
+    gc_memlimit_collected();
+}
+
+/*
+ * Scan old objects for pointers into the nursery. Without an overflow
+ * only the remembered slots and objects are visited, so the cost scales
+ * with old-to-young pointers rather than with the old generation.
+ */
+static void gc_scan_remembered_set(uint8_t *old_end)
+{
+    if (gc_remset.overflow)
+    {
+        uint8_t *ptr = gc_heap.space[gc_heap.active_space];
+        while (ptr < old_end)
+        {
+            gc_header_t *header = (gc_header_t *)ptr;
+            size_t obj_size = GC_HEADER_GET_SIZE(header);
+            if (unlikely(obj_size < GC_HEADER_SIZE) ||
+                unlikely(obj_size & GC_ALIGN_MASK))
+                break;
+            gc_scan_object(gc_get_user_ptr(header));
+            ptr += obj_size;
+        }
+        if (gc_mature_size)
+            gc_mature_walk(gc_scan_object);
+        void *pinned;
+        for (int i = 0; (pinned = gc_pinned_object(i)) != NULL; i++)
+            gc_scan_object(pinned);
+        return;
+    }
+
+    for (uint32_t i = 0; i < gc_remset.count; i++)
+    {
+        uintptr_t entry = gc_remset.entries[i];
+        uintptr_t addr = entry & ~(uintptr_t)GC_REMSET_OBJECT;
+
+        /* A pinned or arena entry may be a stray hit between objects, or
+         * in one freed (gc_pinned_free) or reset (ResetArena) since */
+        if (!gc_in_old_space((void *)addr) && !gc_in_mature((void *)addr) &&
+            !gc_pinned_contains(addr) && !gc_arena_contains(addr))
+            continue;
+
+        if (entry & GC_REMSET_OBJECT)
+            gc_scan_object((void *)(entry & ~(uintptr_t)GC_REMSET_OBJECT));
+        else
+            gc_update_pointer_field((void **)entry);
+    }
+}
+
+/* Copy the nursery survivors to alloc_ptr and scan them there */
+static void gc_promote_nursery(void)
+{
+    gc_set_from_ranges(NULL);
+
+    uint8_t *promote_start = gc_heap.alloc_ptr;
+    gc_heap.scan_ptr = promote_start;
+
+    /* With the remembered set intact, older arena objects are in it */
+    gc_minor_roots = !gc_remset.overflow;
+    gc_scan_roots();
+    gc_minor_roots = false;
+    gc_scan_remembered_set(promote_start);
+
+    /* Survivors of pretenured types were moved to the mature region */
+    gc_drain();
+
+    gc_heap.bytes_promoted = gc_heap.alloc_ptr - promote_start;
+}
+
+/*
+ * gc_minor_collect - Promote nursery survivors into the active semispace.
+ *
+ * Roots are the usual stacks and globals plus the remembered set. The
+ * survivors are appended at alloc_ptr and Cheney-scanned from there, so
+ * the pause is proportional to what survives the nursery, not to the
+ * size of the old generation.
+ */
+void gc_minor_collect(void)
+{
+    if (!gc_heap.initialized)
+    {
+        gc_init();
+        return;
+    }
+
+    if (gc_heap.gc_in_progress)
+        return;
+
+    /* Promotion would mix with the replicas; complete the cycle instead */
+    if (gc_heap.cycle_active)
+    {
+        gc_collect_finish();
+        return;
+    }
+
+    size_t nursery_used = gc_heap.nursery_ptr - gc_heap.nursery;
+    if (nursery_used == 0)
+        return;
+
+    /* Worst case every nursery object survives, and every small-object
+     * slot gains a header (at most doubling its page); if that won't fit,
+     * compact the old generation too. */
+    size_t worst = nursery_used + (size_t)gc_heap.small_pages * GC_SMALL_PAGE_SIZE;
+    if ((size_t)(gc_heap.alloc_limit - gc_heap.alloc_ptr) < worst)
+    {
+        gc_collect();
+        return;
+    }
+
+    save_stack_bounds();
+
+    uint64_t start_time = timer_us_gettime64();
+    gc_trace_start(GC_TRACE_MINOR, start_time);
+
+    gc_heap.gc_in_progress = true;
+    gc_heap.minor_count++;
+
+    gc_promote_nursery();
+
+    gc_heap.bytes_allocated = gc_heap.alloc_ptr - gc_heap.space[gc_heap.active_space];
+    gc_reset_nursery();
+
+    uint64_t elapsed = timer_us_gettime64() - start_time;
+    gc_trace_stop(elapsed);
+    gc_heap.last_minor_pause_us = elapsed;
+    gc_heap.total_minor_pause_us += elapsed;
+
+    gc_heap.gc_in_progress = false;
+    gc_stack_bounds_valid = false;
+}
+
+/* --- Incremental Collection --- */
+
+void gc_collect_start(void)
+{
+    if (!gc_heap.initialized)
+    {
+        gc_init();
+        return;
+    }
+
+    if (gc_heap.gc_in_progress || gc_heap.cycle_active)
+        return;
+
+#if GC_MARK_COMPACT
+    /* No second space to replicate into; compact in one pause instead */
+    gc_collect();
+    return;
+#endif
+
+    save_stack_bounds();
+
+    uint64_t start_time = timer_us_gettime64();
+    gc_trace_start(GC_TRACE_CYCLE_START, start_time);
+
+    gc_heap.gc_in_progress = true;
+    gc_heap.gc_count++;
+    gc_pool_rotate();
+
+    int old_space = gc_heap.active_space;
+    int new_space = 1 - old_space;
+
+    /* Deferred invalidation may still target the space we copy into */
+    gc_heap.pending_invalidate_space = NULL;
+    gc_heap.invalidate_offset = 0;
+
+    gc_heap.from_end = gc_heap.alloc_ptr;
+    gc_set_from_ranges(gc_heap.space[old_space]);
+
+    gc_heap.active_space = new_space;
+    gc_heap.alloc_ptr = gc_heap.space[new_space];
+    gc_heap.alloc_limit = gc_heap.space[new_space] + gc_heap.space_size;
+    gc_heap.scan_ptr = gc_heap.space[new_space];
+
+    /* The mutator keeps using the originals until the cycle finishes.
+     * Pinned and mature objects reached are scanned (and updated) only
+     * then. */
+    memset(gc_heap.card_map[old_space], 0, GC_CARD_MAP_BYTES(gc_heap.space_size));
+    memset(gc_heap.nursery_card_map, 0, GC_CARD_MAP_BYTES(gc_heap.nursery_size));
+
+    gc_pinned_begin_mark();
+    gc_mature_begin_mark();
+    gc_replicating = true;
+    gc_roots_readonly = true;
+    gc_scan_roots();
+    gc_roots_readonly = false;
+
+    gc_heap.cycle_active = true;
+
+    uint64_t elapsed = timer_us_gettime64() - start_time;
+    gc_trace_stop(elapsed);
+    gc_heap.last_pause_us = elapsed;
+    gc_heap.total_pause_us += elapsed;
+
+    gc_heap.gc_in_progress = false;
+    gc_stack_bounds_valid = false;
+}
+
+bool gc_collect_step(uint32_t budget_us)
+{
+    if (!gc_heap.cycle_active)
+        return false;
+
+    /* Interrupted a collection (e.g. called from vblank) - try later */
+    if (gc_heap.gc_in_progress)
+        return true;
+
+    uint64_t start_time = timer_us_gettime64();
+
+    gc_heap.gc_in_progress = true;
+
+    /* Replicas may reference nursery objects allocated since the start */
+    gc_set_from_ranges(gc_heap.space[1 - gc_heap.active_space]);
+
+    bool drained = gc_scan_to_space(start_time + budget_us);
+
+    uint64_t elapsed = timer_us_gettime64() - start_time;
+    gc_heap.last_pause_us = elapsed;
+    gc_heap.total_pause_us += elapsed;
+
+    gc_heap.gc_in_progress = false;
+
+    /* Finishing scans the running goroutine's stack, so never from an IRQ
+     * or from the scheduler on g0; a later step, minor GC or runtime.GC
+     * from a goroutine finishes the drained cycle. */
+    if (drained && !irq_inside_int() && getg() != g0)
+    {
+        gc_collect_finish();
+        return false;
+    }
+    return true;
+}
+
+void gc_card_mark(void *dst, size_t size)
+{
+    uintptr_t addr = (uintptr_t)dst;
+    int from = 1 - gc_heap.active_space;
+    uintptr_t base;
+    uint32_t *map;
+
+    if (addr - (uintptr_t)gc_heap.space[from] < gc_heap.space_size)
+    {
+        base = (uintptr_t)gc_heap.space[from];
+        map = gc_heap.card_map[from];
+    }
+    else if (gc_in_nursery(dst))
+    {
+        base = (uintptr_t)gc_heap.nursery;
+        map = gc_heap.nursery_card_map;
+    }
+    else
+        return;
+
+    if (size == 0)
+        return;
+
+    size_t last = (addr + size - 1 - base) >> GC_CARD_SHIFT;
+    for (size_t c = (addr - base) >> GC_CARD_SHIFT; c <= last; c++)
+        map[c >> 5] |= 1u << (c & 31);
+}
+
+/* Does [lo, hi) overlap a dirty card of the map covering base? */
+static bool gc_card_dirty(const uint32_t *map, const uint8_t *base,
+                          const uint8_t *lo, const uint8_t *hi)
+{
+    size_t last = (size_t)(hi - 1 - base) >> GC_CARD_SHIFT;
+    for (size_t c = (size_t)(lo - base) >> GC_CARD_SHIFT; c <= last; c++)
+    {
+        if (map[c >> 5] & (1u << (c & 31)))
+            return true;
+    }
+    return false;
+}
+
+/* Copy one element's words from src that dst lacks: scalars, and pointers
+ * that do not point into a space being evacuated (nil, malloc'd, static,
+ * pinned or mature memory). */
+static void gc_refresh_element(void **dst, void *const *src, size_t nwords,
+                               const gc_scan_plan_t *plan)
+{
+    uint32_t next = 0;
+
+    for (size_t w = 0; w < nwords; w++)
+    {
+        bool is_ptr = false;
+        if (w < plan->nwords)
+        {
+            if (plan->bitmap)
+                is_ptr = (plan->bitmap[w >> 3] >> (w & 7)) & 1;
+            else if (next < plan->count && plan->offsets[next] == w * sizeof(void *))
+            {
+                is_ptr = true;
+                next++;
+            }
+        }
+
+        void *v = src[w];
+        if (dst[w] == v || (is_ptr && gc_in_from_space((uintptr_t)v)))
+            continue;
+
+        dst[w] = v;
+        if (is_ptr)
+            gc_update_pointer_field(&dst[w]); /* Marks pinned and mature */
+    }
+}
+
+/*
+ * Bring a replica whose original lies on clean cards up to date without
+ * rescanning it. Its pointer fields can only have changed through barriered
+ * stores (which dirty the card) or to memory that does not move, so only
+ * scalars and non-moving pointers are copied back. Returns false if the
+ * pointer layout is unknown and the replica needs a full resync.
+ */
+static bool gc_refresh_replica(void *replica, const void *orig, size_t size)
+{
+    gc_header_t *header = gc_get_header(replica);
+    struct __go_type_descriptor *type = header->type;
+
+    if (GC_HEADER_IS_NOSCAN(header) || (type && type->__ptrdata == 0))
     {
-        gc_header_t *header = (gc_header_t *)gc_heap.scan_ptr;
+        memcpy(replica, orig, size);
+        return true;
+    }
+
+    uintptr_t type_addr = (uintptr_t)type;
+    if (!(type_addr >= 0x8c000000 && type_addr < 0x8d000000) &&
+        !(type_addr >= 0xac000000 && type_addr < 0xad000000))
+        return false;
+
+    const gc_scan_plan_t *plan = gc_scan_plan(type);
+    size_t elem_size = type->__size;
+    if (!plan || elem_size == 0 || elem_size > size ||
+        size / elem_size > gc_heap.space_size / sizeof(void *))
+        return false;
+
+    size_t n = size / elem_size;
+    for (size_t i = 0; i < n; i++)
+        gc_refresh_element((void **)((uint8_t *)replica + i * elem_size),
+                           (void *const *)((const uint8_t *)orig + i * elem_size),
+                           elem_size / sizeof(void *), plan);
+
+    /* Pointer-bearing types are word-sized multiples; copy any slack */
+    size_t tail = n * elem_size;
+    memcpy((uint8_t *)replica + tail, (const uint8_t *)orig + tail, size - tail);
+    return true;
+}
+
+/*
+ * Refresh the replica of every forwarded object in [lo, hi) from its
+ * original. Replicas on cards the write barrier dirtied are re-copied and
+ * rescanned; the rest only get the scalar words gccgo stores without a
+ * barrier (gc_refresh_replica).
+ */
+static void gc_resync_replicas(uint8_t *lo, uint8_t *hi, const uint32_t *cards)
+{
+    uint8_t *ptr = lo;
+
+    while (ptr < hi)
+    {
+        gc_header_t *header = (gc_header_t *)ptr;
         size_t obj_size = GC_HEADER_GET_SIZE(header);
 
         if (unlikely(obj_size < GC_HEADER_SIZE) ||
-            unlikely(obj_size > gc_heap.space_size) ||
             unlikely(obj_size & GC_ALIGN_MASK))
             break;
 
-        uint8_t *next_obj = gc_heap.scan_ptr + obj_size;
-        if (next_obj < gc_heap.alloc_ptr)
-            GC_PREFETCH(next_obj);
+        if (GC_HEADER_IS_FORWARDED(header))
+        {
+            void *replica = GC_HEADER_GET_FORWARD(header);
+            void *orig = gc_get_user_ptr(header);
+            size_t size = obj_size - GC_HEADER_SIZE;
 
-        void *obj = gc_get_user_ptr(header);
-        gc_scan_object(obj);
-        gc_heap.scan_ptr += obj_size;
+            if (gc_card_dirty(cards, lo, ptr, ptr + obj_size) ||
+                !gc_refresh_replica(replica, orig, size))
+            {
+                memcpy(replica, orig, size);
+                gc_scan_object(replica);
+            }
+        }
+        ptr += obj_size;
+    }
+}
+
+void gc_collect_finish(void)
+{
+    if (!gc_heap.cycle_active || gc_heap.gc_in_progress)
+        return;
+
+    save_stack_bounds();
+
+    uint64_t start_time = timer_us_gettime64();
+    gc_trace_start(GC_TRACE_CYCLE_FINISH, start_time);
+
+    gc_heap.gc_in_progress = true;
+    gc_replicating = false;
+
+    uint8_t *from_space = gc_heap.space[1 - gc_heap.active_space];
+    uint8_t *to_end = gc_heap.space[gc_heap.active_space] + gc_heap.space_size;
+    gc_set_from_ranges(from_space);
+
+    /* Objects allocated at the top of to-space during the cycle hold
+     * from-space pointers; evacuate them below the grey region too. */
+    if (gc_heap.alloc_limit < to_end)
+        gc_add_from_range((uintptr_t)gc_heap.alloc_limit, (uintptr_t)to_end);
+
+    gc_scan_roots();
+    gc_resync_replicas(from_space, gc_heap.from_end,
+                       gc_heap.card_map[1 - gc_heap.active_space]);
+    gc_resync_replicas(gc_heap.nursery, gc_heap.nursery_ptr,
+                       gc_heap.nursery_card_map);
+    gc_drain();
+    gc_pinned_sweep();
+    gc_mature_sweep();
+
+    int to = gc_heap.active_space;
+    gc_start_map_clear(gc_heap.start_map[to], gc_heap.space[to],
+                       gc_heap.alloc_limit, to_end);
+    gc_start_map_clear(gc_heap.start_map[1 - to], from_space,
+                       from_space, gc_heap.from_end);
+    if (gc_heap.alloc_limit < to_end)
+    {
+        /* The dead top allocations were written through the cache, and
+         * promotion copies over them with the store queues */
+        dcache_purge_range((uintptr_t)gc_heap.alloc_limit,
+                           to_end - gc_heap.alloc_limit);
+        gc_heap.clean_from[to] = to_end;
     }
+    if (gc_heap.clean_from[1 - to] < gc_heap.from_end)
+        gc_heap.clean_from[1 - to] = gc_heap.from_end;
+    gc_heap.alloc_limit = to_end;
 
     size_t after_size = gc_heap.alloc_ptr - gc_heap.space[gc_heap.active_space];
     gc_heap.bytes_copied = after_size;
     gc_heap.bytes_allocated = after_size;
+    gc_reset_nursery();
 
-    /* Defer cache invalidation */
-    gc_heap.pending_invalidate_space = gc_heap.space[old_space];
+    gc_heap.pending_invalidate_space = from_space;
     gc_heap.invalidate_offset = 0;
+    gc_heap.cycle_active = false;
 
     uint64_t elapsed = timer_us_gettime64() - start_time;
+    gc_trace_stop(elapsed);
     gc_heap.last_pause_us = elapsed;
     gc_heap.total_pause_us += elapsed;
+    gc_pacer_collected(GC_TRACE_CYCLE_FINISH);
+    gc_pretenure_collected();
 
     gc_heap.gc_in_progress = false;
     gc_stack_bounds_valid = false;
+    gc_memlimit_collected();
 }
 
 /* GC inhibit for map operations that hold derived pointers */
@@ -229,7 +972,9 @@ bool gc_invalidate_incremental(void)
     }
 
     uintptr_t to_invalidate = (remaining < chunk_size) ? remaining : chunk_size;
+    uint64_t start_time = timer_us_gettime64();
     dcache_inval_range(base + gc_heap.invalidate_offset, to_invalidate);
+    gc_trace_charge_invalidate((uint32_t)(timer_us_gettime64() - start_time));
     gc_heap.invalidate_offset += to_invalidate;
 
     if (gc_heap.invalidate_offset >= gc_heap.space_size)
@@ -246,11 +991,105 @@ bool gc_invalidation_pending(void)
     return gc_heap.pending_invalidate_space != NULL;
 }
 
-int gc_invalidate_on_vblank(uint32_t budget_us)
+/* Write a cache line back and drop it */
+static inline void gc_purge_line(void *p)
 {
-    if (!gc_heap.pending_invalidate_space)
-        return 0;
+    __asm__ volatile("ocbp @%0" : : "r"(p) : "memory");
+}
+
+/*
+ * Zero [lo, hi). Whole cache lines are cleared with movca.l, which
+ * allocates the line without reading RAM.
+ *
+ * Semispace memory is a future gc_sq_copy() target, and store queue
+ * writes bypass the cache, so it must not be left there (purge). It is
+ * cleared through the store queues, or line by line and purged when we
+ * have interrupted code that may be using the store queues itself.
+ */
+static void gc_zero_range(uint8_t *lo, uint8_t *hi, bool purge)
+{
+    uint8_t *a = (uint8_t *)(((uintptr_t)lo + 31) & ~(uintptr_t)31);
+    uint8_t *b = (uint8_t *)((uintptr_t)hi & ~(uintptr_t)31);
+
+    if (a >= b)
+    {
+        memset(lo, 0, hi - lo);
+        if (purge)
+        {
+            gc_purge_line(lo);
+            gc_purge_line(hi - 1);
+        }
+        return;
+    }
+    memset(lo, 0, a - lo);
+    memset(b, 0, hi - b);
+    if (purge && a != lo)
+        gc_purge_line(lo);
+    if (purge && b != hi)
+        gc_purge_line(b);
+
+    if (purge && !irq_inside_int())
+    {
+        gc_sq_clear(a, b - a);
+        return;
+    }
 
+    for (uint32_t *line = (uint32_t *)a; line < (uint32_t *)b; line += 8)
+    {
+        __asm__ volatile("movca.l r0, @%0" : : "r"(line), "z"(0) : "memory");
+        line[1] = 0;
+        line[2] = 0;
+        line[3] = 0;
+        line[4] = 0;
+        line[5] = 0;
+        line[6] = 0;
+        line[7] = 0;
+        if (purge)
+            gc_purge_line(line);
+    }
+}
+
+/* Lower *clean_from by up to one chunk, clearing down towards lo */
+static bool gc_prezero_chunk(uint8_t **clean_from, uint8_t *lo, bool purge)
+{
+    const size_t chunk_size = 16 * 1024;
+
+    if (*clean_from <= lo)
+        return false;
+
+    uint8_t *hi = *clean_from;
+    uint8_t *start = (size_t)(hi - lo) > chunk_size ? hi - chunk_size : lo;
+    gc_zero_range(start, hi, purge);
+    *clean_from = start;
+    return true;
+}
+
+bool gc_prezero_incremental(void)
+{
+    if (!gc_heap.initialized || gc_heap.gc_in_progress || gc_heap.cycle_active)
+        return false;
+
+    /* The nursery first: most allocations land there */
+    if (gc_prezero_chunk(&gc_heap.nursery_clean_from, gc_heap.nursery_ptr, false))
+        return true;
+
+    int active = gc_heap.active_space;
+    if (gc_prezero_chunk(&gc_heap.clean_from[active], gc_heap.alloc_ptr, true))
+        return true;
+
+#if !GC_MARK_COMPACT
+    /* Invalidation would throw away the zeros, so wait for it */
+    if (gc_heap.pending_invalidate_space)
+        return false;
+    int idle = 1 - active;
+    if (gc_prezero_chunk(&gc_heap.clean_from[idle], gc_heap.space[idle], true))
+        return true;
+#endif
+    return false;
+}
+
+int gc_invalidate_on_vblank(uint32_t budget_us)
+{
     uint64_t deadline = timer_us_gettime64() + budget_us;
 
     while (gc_heap.pending_invalidate_space)
@@ -261,7 +1100,17 @@ int gc_invalidate_on_vblank(uint32_t budget_us)
     }
 
     if (!gc_heap.pending_invalidate_space)
+    {
+        /* Spend what is left of vblank on the incremental collector, or
+         * else on clearing free memory */
+        uint64_t now = timer_us_gettime64();
+        if (gc_heap.cycle_active && now < deadline)
+            gc_collect_step((uint32_t)(deadline - now));
+        else
+            while (timer_us_gettime64() < deadline && gc_prezero_incremental())
+                ;
         return 0;
+    }
 
     const uintptr_t chunk_size = 64 * 1024;
     return (int)((gc_heap.space_size - gc_heap.invalidate_offset + chunk_size - 1) / chunk_size);
@@ -269,6 +1118,75 @@ int gc_invalidate_on_vblank(uint32_t budget_us)
 
 /* --- Object Copying --- */
 
+/*
+ * To-space overflow is FATAL. We cannot return the old pointer because
+ * it's in from-space which will be invalid after GC. Returning it would
+ * cause silent use-after-free corruption.
+ *
+ * If you hit this, your heap is too small for your live data.
+ * Increase GC_SEMISPACE_SIZE_KB (or runtime.SetHeapSize) or reduce
+ * allocation rate.
+ */
+static void gc_to_space_overflow(void)
+{
+    runtime_throw(
+        "GC to-space overflow - your live data doesn't fit in the heap.\n"
+        "You have too much live data, not a GC bug. Options:\n"
+        "  1. Increase GC_SEMISPACE_SIZE_KB (costs RAM)\n"
+        "  2. Allocate less (reuse objects, use pools)\n"
+        "  3. Call runtime.GC() more often to free garbage earlier");
+}
+
+/*
+ * Copy the small-object slot containing addr out of its page, as an
+ * ordinary NOSCAN object, and return addr's new address. Returns NULL if
+ * addr is not inside a handed-out slot (a stale or conservative value),
+ * or while replicating: the slot is copied when the cycle finishes.
+ */
+static void *gc_copy_small(gc_header_t *page_header, uintptr_t addr)
+{
+    gc_small_page_t *page = gc_get_user_ptr(page_header);
+    uint8_t *slots = gc_small_slots(page);
+
+    if (addr < (uintptr_t)slots)
+        return NULL;
+
+    size_t i = (addr - (uintptr_t)slots) / page->slot_size;
+    if (i >= page->used)
+        return NULL;
+
+    uint8_t *slot = slots + i * page->slot_size;
+    uint32_t bit = 1u << (i & 31);
+    if (page->forwarded[i >> 5] & bit)
+        return *(uint8_t **)slot + (addr - (uintptr_t)slot);
+
+    if (gc_replicating)
+        return NULL;
+
+    size_t obj_size = GC_HEADER_SIZE + page->slot_size;
+    if (unlikely(gc_heap.alloc_ptr + obj_size > gc_heap.alloc_limit))
+        gc_to_space_overflow();
+
+    gc_header_t *new_header = (gc_header_t *)gc_heap.alloc_ptr;
+    GC_HEADER_SET(new_header, 0, obj_size);
+    new_header->type = NULL;
+    GC_HEADER_SET_NOSCAN(new_header);
+    uint8_t *new_ptr = gc_get_user_ptr(new_header);
+    memcpy(new_ptr, slot, page->slot_size);
+
+    gc_heap.alloc_ptr += obj_size;
+    gc_trace_objects++;
+    gc_trace_bytes += obj_size;
+    gc_start_map_set(gc_heap.start_map[gc_heap.active_space],
+                     gc_heap.start_back[gc_heap.active_space],
+                     gc_heap.space[gc_heap.active_space], new_header, obj_size);
+
+    *(uint8_t **)slot = new_ptr;
+    page->forwarded[i >> 5] |= bit;
+
+    return new_ptr + (addr - (uintptr_t)slot);
+}
+
 /* Copy object from old space to new space, return new address. */
 static void *gc_copy_object(void *ptr)
 {
@@ -279,11 +1197,9 @@ static void *gc_copy_object(void *ptr)
 
     // Check if this is even a heap pointer
     uintptr_t addr = (uintptr_t)ptr;
-    uint8_t *old_space = gc_heap.space[1 - gc_heap.active_space];
 
-    // Must be in old (from) space
-    if (addr < (uintptr_t)old_space ||
-        addr >= (uintptr_t)(old_space + gc_heap.space_size))
+    // Must be in from-space (old semispace or nursery)
+    if (!gc_in_from_space(addr))
     {
         // Not in from-space, might be external or already copied
         return ptr;
@@ -352,26 +1268,30 @@ static void *gc_copy_object(void *ptr)
      */
     size_t aligned_obj_size = (obj_size + GC_ALIGN_MASK) & ~GC_ALIGN_MASK;
 
-    gc_header_t *new_header = (gc_header_t *)gc_heap.alloc_ptr;
+    /* Survivors of the old semispace are the pretenuring feedback */
+    if ((uintptr_t)header - (uintptr_t)gc_heap.space[1 - gc_heap.active_space] <
+        gc_heap.space_size)
+        gc_pretenure_survivor(header->type, aligned_obj_size);
 
-    if (unlikely(gc_heap.alloc_ptr + aligned_obj_size > gc_heap.alloc_limit))
+    /* Objects of pretenured types move to the mature region instead. Not
+     * while replicating: the originals are resynced into to-space. */
+    if (unlikely(gc_pretenure_hit(header->type)) && !gc_replicating)
     {
-        /*
-         * To-space overflow is FATAL. We cannot return the old pointer
-         * because it's in from-space which will be invalid after GC.
-         * Returning ptr here would cause silent use-after-free corruption.
-         *
-         * If you hit this, your heap is too small for your live data.
-         * Increase GC_SEMISPACE_SIZE_KB or reduce allocation rate.
-         */
-        runtime_throw(
-            "GC to-space overflow - your live data doesn't fit in the heap.\n"
-            "You have too much live data, not a GC bug. Options:\n"
-            "  1. Increase GC_SEMISPACE_SIZE_KB (costs RAM)\n"
-            "  2. Allocate less (reuse objects, use pools)\n"
-            "  3. Call runtime.GC() more often to free garbage earlier");
+        void *mature_ptr = gc_pretenure_copy(header);
+        if (mature_ptr != NULL)
+        {
+            gc_trace_objects++;
+            gc_trace_bytes += aligned_obj_size;
+            GC_HEADER_SET_FORWARD(header, mature_ptr);
+            return mature_ptr;
+        }
     }
 
+    gc_header_t *new_header = (gc_header_t *)gc_heap.alloc_ptr;
+
+    if (unlikely(gc_heap.alloc_ptr + aligned_obj_size > gc_heap.alloc_limit))
+        gc_to_space_overflow();
+
     /*
      * Use Store Queue for large object copies.
      * SQ gives ~3x speedup for objects > 128 bytes (textures, large arrays).
@@ -382,6 +1302,11 @@ static void *gc_copy_object(void *ptr)
      */
     gc_sq_copy(new_header, header, obj_size);
     gc_heap.alloc_ptr += aligned_obj_size;
+    gc_trace_objects++;
+    gc_trace_bytes += aligned_obj_size;
+    gc_start_map_set(gc_heap.start_map[gc_heap.active_space],
+                     gc_heap.start_back[gc_heap.active_space],
+                     gc_heap.space[gc_heap.active_space], new_header, obj_size);
 
     // Calculate new user pointer
     void *new_ptr = gc_get_user_ptr(new_header);
@@ -389,11 +1314,80 @@ static void *gc_copy_object(void *ptr)
     // Leave forwarding pointer in old object
     GC_HEADER_SET_FORWARD(header, new_ptr);
 
+    if (gc_heap.depth_first && gc_dfs_count < GC_DFS_STACK_ENTRIES &&
+        !GC_HEADER_IS_NOSCAN(new_header))
+        gc_dfs_stack[gc_dfs_count++] = new_ptr;
+
     return new_ptr;
 }
 
 /* --- Object Scanning --- */
 
+/* De Bruijn MSB table - SH-4 has no CLZ instruction */
+static const uint8_t msb_debruijn32[32] = {
+    0, 9, 1, 10, 13, 21, 2, 29, 11, 14, 16, 18, 22, 25, 3, 30,
+    8, 12, 20, 28, 15, 17, 24, 7, 19, 27, 23, 6, 26, 5, 4, 31};
+
+/* Find position of highest set bit (v must be non-zero) */
+static inline int msb32(uint32_t v)
+{
+    v |= v >> 1;
+    v |= v >> 2;
+    v |= v >> 4;
+    v |= v >> 8;
+    v |= v >> 16;
+    return msb_debruijn32[(uint32_t)(v * 0x07C4ACDDU) >> 27];
+}
+
+/*
+ * Find the object containing addr in the region at base, from its start
+ * map and block back offsets.
+ *
+ * Looks for the last header at or before the granule before addr (the
+ * header always precedes the addresses it owns) in addr's block. If there
+ * is none, the object spans into the block from an earlier one, and its
+ * header is the last in the block back[] points to. Returns NULL for
+ * addresses in a gap past the end of the nearest object.
+ */
+gc_header_t *gc_start_map_find(const uint32_t *map, const uint16_t *back,
+                               uintptr_t base, uintptr_t addr)
+{
+    if (addr < base + GC_HEADER_SIZE)
+        return NULL;
+
+    size_t g = (addr - base - GC_HEADER_SIZE) / GC_ALIGN;
+    size_t w = g >> 5;
+    uint32_t bits = map[w] & (0xFFFFFFFFu >> (31 - (g & 31)));
+
+    if (bits == 0)
+    {
+        if (back[w] == 0 || back[w] > w)
+            return NULL;
+        w -= back[w];
+        bits = map[w];
+        if (bits == 0)
+            return NULL;
+    }
+
+    gc_header_t *header =
+        (gc_header_t *)(base + (((w << 5) + msb32(bits)) * GC_ALIGN));
+    if (addr >= (uintptr_t)header + GC_HEADER_GET_SIZE(header))
+        return NULL;
+    return header;
+}
+
+/* Find the object containing addr, which must be in from-space */
+static gc_header_t *gc_find_object(uintptr_t addr)
+{
+    if (gc_in_nursery((void *)addr))
+        return gc_start_map_find(gc_heap.nursery_start_map, gc_heap.nursery_start_back,
+                                 (uintptr_t)gc_heap.nursery, addr);
+
+    int s = (addr - (uintptr_t)gc_heap.space[0]) < gc_heap.space_size ? 0 : 1;
+    return gc_start_map_find(gc_heap.start_map[s], gc_heap.start_back[s],
+                             (uintptr_t)gc_heap.space[s], addr);
+}
+
 /*
  * Update pointer field: copy if in from-space, update to new address.
  * Validates pointer is in valid RAM before following. Skips non-heap
@@ -407,6 +1401,12 @@ static void gc_update_pointer_field(void **field)
         return;
     }
 
+    if (unlikely(gc_walk_visit != NULL))
+    {
+        gc_walk_visit(field);
+        return;
+    }
+
     uintptr_t addr = (uintptr_t)old_ptr;
 
     /*
@@ -443,28 +1443,54 @@ static void gc_update_pointer_field(void **field)
      *   - Stack pointers (on the stack, above heap)
      *   - External allocations (may be anywhere, but not in from-space)
      */
-    uint8_t *from_space = gc_heap.space[1 - gc_heap.active_space];
-    uintptr_t from_lo = (uintptr_t)from_space;
-    uintptr_t from_hi = (uintptr_t)(from_space + gc_heap.space_size);
-
-    if (addr < from_lo || addr >= from_hi)
+    if (!gc_in_from_space(addr))
     {
         /*
          * Pointer is NOT in from-space. Do not modify it.
          * This is the normal case for interface{} type pointers,
-         * static data pointers, and stack pointers.
+         * static data pointers, and stack pointers. Pinned and mature
+         * objects never move; record that they are still reachable.
          */
+        if (gc_maybe_pinned(addr))
+            gc_pinned_mark(addr);
+        else if (gc_in_mature((void *)addr))
+            gc_mature_mark(addr);
         return;
     }
 
     /*
-     * Pointer IS in from-space. This is a heap pointer that needs to
-     * be copied/forwarded. Call gc_copy_object to handle it.
+     * Pointer IS in from-space. It may point into the middle of its
+     * object (sub-slice, &arr[i], substring), so find the object first
+     * and keep the offset across the move.
      */
-    void *new_ptr = gc_copy_object(old_ptr);
+    gc_header_t *header = gc_find_object(addr);
+    if (header == NULL)
+        return;
+    if (gc_conservative && !gc_validate_header(header))
+        return;
+
+#if GC_MARK_COMPACT
+    if (gc_compact_phase != GC_COMPACT_OFF)
+    {
+        gc_compact_pointer_field(field, header);
+        return;
+    }
+#endif
+
+    if (unlikely(GC_HEADER_GET_TAG(header) == GC_TAG_SMALL_PAGE))
+    {
+        void *slot_ptr = gc_copy_small(header, addr);
+        if (slot_ptr != NULL && !gc_roots_readonly)
+            *field = slot_ptr;
+        return;
+    }
+
+    uint8_t *base = gc_get_user_ptr(header);
+    uint8_t *new_base = gc_copy_object(base);
+    void *new_ptr = new_base + (addr - (uintptr_t)base);
 
     // Update the field if the object was moved
-    if (new_ptr != old_ptr)
+    if (new_ptr != old_ptr && !gc_roots_readonly)
     {
         *field = new_ptr;
     }
@@ -645,9 +1671,8 @@ static void gc_scan_single_element(void *elem, struct __go_type_descriptor *type
         }
     }
 
-    // Check if type uses GC program (KindGCProg) instead of bitmap
-    // GC programs are used for large types (typically >128 bytes of ptrdata)
-    // For Dreamcast, fall back to conservative scan for these rare cases
+    // Type uses a GC program (KindGCProg) that gc_scan_plan() could not
+    // expand - fall back to conservative scan
     if (GC_TYPE_USES_GCPROG(type))
     {
         gc_scan_range_conservative(elem, type->__ptrdata);
@@ -666,6 +1691,20 @@ static void gc_scan_single_element(void *elem, struct __go_type_descriptor *type
     }
 }
 
+/* Scan one element with its type's cached plan (gc_scan_plan.c) */
+static inline void gc_scan_with_plan(void *elem, const gc_scan_plan_t *plan)
+{
+    if (plan->bitmap)
+    {
+        gc_scan_gcdata_bitmap(elem, plan->bitmap, plan->nwords);
+        return;
+    }
+
+    const uint32_t *offsets = plan->offsets;
+    for (uint32_t i = 0; i < plan->count; i++)
+        gc_update_pointer_field((void **)((uint8_t *)elem + offsets[i]));
+}
+
 // Scan an object for pointer fields
 static void gc_scan_object(void *obj)
 {
@@ -714,6 +1753,9 @@ static void gc_scan_object(void *obj)
         return; // "noscan" object
     }
 
+    /* Precomputed pointer offsets or bitmap; NULL falls back below */
+    const gc_scan_plan_t *plan = gc_scan_plan(type);
+
     /* Case 3: Array allocation - obj_size > type->size means multiple elements */
     /* The compiler calls mallocgc with element type but allocates n * elem_size */
     if (type->__size > 0 && obj_size > type->__size)
@@ -735,6 +1777,14 @@ static void gc_scan_object(void *obj)
             return;
         }
 
+        if (plan)
+        {
+            uint8_t *elem = obj;
+            for (size_t i = 0; i < n_elements; i++, elem += type->__size)
+                gc_scan_with_plan(elem, plan);
+            return;
+        }
+
         for (size_t i = 0; i < n_elements; i++)
         {
             void *elem = (uint8_t *)obj + i * type->__size;
@@ -746,14 +1796,17 @@ static void gc_scan_object(void *obj)
     /*
      * Case 4: Single object.
      *
-     * gc_scan_single_element handles ALL sub-cases:
+     * Without a plan, gc_scan_single_element handles ALL sub-cases:
      * - Has gcdata bitmap: precise scan
      * - Uses GCProg: conservative scan of ptrdata region
      * - No gcdata: conservative scan of ptrdata region
      *
      * The old type-kind switch was dead code - we never reached it.
      */
-    gc_scan_single_element(obj, type);
+    if (plan)
+        gc_scan_with_plan(obj, plan);
+    else
+        gc_scan_single_element(obj, type);
 }
 
 /* Header validation to reject invalid pointers during conservative scanning */
@@ -781,8 +1834,9 @@ static inline bool gc_validate_header(gc_header_t *header)
         uintptr_t fwd = (uintptr_t)GC_HEADER_GET_FORWARD(header);
         uint8_t *to_space = gc_heap.space[gc_heap.active_space];
 
-        if (fwd < (uintptr_t)to_space ||
-            fwd >= (uintptr_t)(to_space + gc_heap.space_size))
+        if ((fwd < (uintptr_t)to_space ||
+             fwd >= (uintptr_t)(to_space + gc_heap.space_size)) &&
+            !gc_in_mature((void *)fwd))
         {
             return false;
         }
@@ -832,9 +1886,10 @@ static inline bool gc_validate_header(gc_header_t *header)
             uintptr_t heap1_lo = (uintptr_t)space1;
             uintptr_t heap1_hi = heap1_lo + gc_heap.space_size;
 
-            /* Reject if type pointer is in either semispace */
+            /* Reject if type pointer is in either semispace or the nursery */
             if ((type_addr >= heap0_lo && type_addr < heap0_hi) ||
-                (type_addr >= heap1_lo && type_addr < heap1_hi))
+                (type_addr >= heap1_lo && type_addr < heap1_hi) ||
+                gc_in_nursery(type))
             {
                 return false;
             }
@@ -860,105 +1915,12 @@ static inline bool gc_validate_header(gc_header_t *header)
     return true;
 }
 
-/* Check if pointer is to a valid object start, rejecting interior pointers. */
-static bool gc_is_valid_object_start(void *ptr)
-{
-    if (!ptr)
-        return false;
-
-    uintptr_t addr = (uintptr_t)ptr;
-    uint8_t *old_space = gc_heap.space[1 - gc_heap.active_space];
-
-    /* Must be in from-space with room for header before it */
-    if (addr < (uintptr_t)(old_space + GC_HEADER_SIZE) ||
-        addr >= (uintptr_t)(old_space + gc_heap.space_size))
-    {
-        return false;
-    }
-
-    /* Check alignment - all GC objects are 8-byte aligned */
-    if (addr & GC_ALIGN_MASK)
-        return false;
-
-    /* Get the header and validate its structure */
-    gc_header_t *header = gc_get_header(ptr);
-
-    if (!gc_validate_header(header))
-        return false;
-
-    size_t obj_size = GC_HEADER_GET_SIZE(header);
-
-    /*
-     * Interior pointer rejection.
-     *
-     * Calculate where the object SHOULD end based on header size.
-     * The user pointer (ptr) is at header + GC_HEADER_SIZE.
-     * Object data size is obj_size - GC_HEADER_SIZE.
-     *
-     * For a valid object start, header + obj_size should equal
-     * the object end, which must be within the heap.
-     */
-    uintptr_t obj_end = (uintptr_t)header + obj_size;
-    if (obj_end > (uintptr_t)(old_space + gc_heap.space_size))
-        return false;
-
-    /*
-     * Additional interior pointer check.
-     *
-     * Walk backwards from this address to see if there's a "better"
-     * header that claims to own this address. If so, reject.
-     *
-     * This is expensive so we only do it for suspicious cases:
-     * objects that seem very small relative to their claimed position.
-     *
-     * Heuristic: if claimed object size is less than 64 bytes,
-     * and we're far into the heap, double-check.
-     *
-     * Disabled for now - adds ~10 cycles and most corruption is caught
-     * by the validation above. Enable with GODC_PARANOID if needed.
-     */
-#ifdef GODC_PARANOID
-    if (obj_size < 64)
-    {
-        /* Check if a previous object overlaps this address */
-        uintptr_t check_addr = (uintptr_t)header - GC_HEADER_SIZE;
-        if (check_addr >= (uintptr_t)old_space)
-        {
-            gc_header_t *prev = (gc_header_t *)check_addr;
-            size_t prev_size = GC_HEADER_GET_SIZE(prev);
-
-            if (prev_size >= GC_HEADER_SIZE &&
-                prev_size <= gc_heap.space_size &&
-                (prev_size & GC_ALIGN_MASK) == 0)
-            {
-                /* Previous "header" claims to be valid */
-                uintptr_t prev_end = check_addr + prev_size;
-                if (prev_end > (uintptr_t)header)
-                {
-                    /* Previous object would overlap - reject as interior */
-                    return false;
-                }
-            }
-        }
-    }
-#endif
-
-    return true;
-}
-
 /*
  * 8x unrolled conservative scan. Loads 8 words, filters against heap bounds,
  * only calls update for actual heap pointers. ~8x fewer function calls than
  * naive loop. SH-4: prefetch hides ~10 cycle cache miss penalty.
  */
 
-/* Heap bounds - cached for inner loop (avoid repeated gc_heap access) */
-typedef struct
-{
-    uintptr_t lo; /* Lowest valid heap address */
-    uintptr_t hi; /* One past highest valid heap address */
-} heap_bounds_t;
-
 /*
  * Inline heap range check - the HOT filter.
  *
@@ -979,10 +1941,10 @@ static inline bool gc_might_be_heap_ptr(uintptr_t val, heap_bounds_t bounds)
      * huge positive number, which fails the < check. Two comparisons
      * become one subtraction + one comparison.
      *
-     * Also checks alignment in the same expression.
+     * No alignment check: interior pointers (&buf[3], substrings) can
+     * have any alignment.
      */
-    return ((val - bounds.lo) < (bounds.hi - bounds.lo)) &&
-           ((val & GC_ALIGN_MASK) == 0);
+    return (val - bounds.lo) < (bounds.hi - bounds.lo);
 }
 
 /*
@@ -996,7 +1958,6 @@ static inline bool gc_might_be_heap_ptr(uintptr_t val, heap_bounds_t bounds)
 void gc_scan_range_conservative(void *start, size_t size)
 {
     void **p, **end;
-    uint8_t *old_space;
     heap_bounds_t bounds;
 
     uintptr_t start_addr = (uintptr_t)start;
@@ -1009,30 +1970,25 @@ void gc_scan_range_conservative(void *start, size_t size)
     if (size == 0)
         return;
 
-    old_space = gc_heap.space[1 - gc_heap.active_space];
     p = (void **)start;
     end = (void **)((uint8_t *)start + size);
 
     /*
      * Cache heap bounds in local struct.
-     * Avoids repeated gc_heap global access in the hot loop.
+     * Avoids repeated global access in the hot loop.
      */
-    bounds.lo = (uintptr_t)old_space;
-    bounds.hi = (uintptr_t)(old_space + gc_heap.space_size);
+    bounds = gc_from_hull;
+    gc_conservative = true;
 
     /*
      * 8x unrolled loop with batched filtering.
      *
      * The magic: we read 8 values into local variables, then filter them
      * through the fast heap check. Only values that pass the filter go
-     * through the expensive gc_is_valid_object_start() check.
-     *
-     * On a typical stack:
-     *   - ~90% of words are NOT in heap range (fast reject)
-     *   - ~9% are in range but not valid objects (misaligned, interior)
-     *   - ~1% are actual heap pointers (call update)
+     * to gc_update_pointer_field(), which resolves them through the
+     * object-start map (exact and interior pointers alike).
      *
-     * This means 8 reads, ~0.8 full checks, ~0.08 updates per iteration.
+     * On a typical stack ~90% of words are NOT in heap range (fast reject).
      */
     while (p + 8 <= end)
     {
@@ -1051,39 +2007,31 @@ void gc_scan_range_conservative(void *start, size_t size)
         /*
          * Batched heap check with fast reject.
          *
-         * Each check: ~3 cycles if rejected (common), ~30+ cycles if accepted.
-         * The gc_is_valid_object_start is expensive but rarely called.
+         * Each check: ~3 cycles if rejected (common). Accepted values cost
+         * one start-map lookup (at most two map words) and a header check.
          */
-        if (v0 && gc_might_be_heap_ptr(v0, bounds) &&
-            gc_is_valid_object_start((void *)v0))
+        if (v0 && gc_might_be_heap_ptr(v0, bounds))
             gc_update_pointer_field(&p[0]);
 
-        if (v1 && gc_might_be_heap_ptr(v1, bounds) &&
-            gc_is_valid_object_start((void *)v1))
+        if (v1 && gc_might_be_heap_ptr(v1, bounds))
             gc_update_pointer_field(&p[1]);
 
-        if (v2 && gc_might_be_heap_ptr(v2, bounds) &&
-            gc_is_valid_object_start((void *)v2))
+        if (v2 && gc_might_be_heap_ptr(v2, bounds))
             gc_update_pointer_field(&p[2]);
 
-        if (v3 && gc_might_be_heap_ptr(v3, bounds) &&
-            gc_is_valid_object_start((void *)v3))
+        if (v3 && gc_might_be_heap_ptr(v3, bounds))
             gc_update_pointer_field(&p[3]);
 
-        if (v4 && gc_might_be_heap_ptr(v4, bounds) &&
-            gc_is_valid_object_start((void *)v4))
+        if (v4 && gc_might_be_heap_ptr(v4, bounds))
             gc_update_pointer_field(&p[4]);
 
-        if (v5 && gc_might_be_heap_ptr(v5, bounds) &&
-            gc_is_valid_object_start((void *)v5))
+        if (v5 && gc_might_be_heap_ptr(v5, bounds))
             gc_update_pointer_field(&p[5]);
 
-        if (v6 && gc_might_be_heap_ptr(v6, bounds) &&
-            gc_is_valid_object_start((void *)v6))
+        if (v6 && gc_might_be_heap_ptr(v6, bounds))
             gc_update_pointer_field(&p[6]);
 
-        if (v7 && gc_might_be_heap_ptr(v7, bounds) &&
-            gc_is_valid_object_start((void *)v7))
+        if (v7 && gc_might_be_heap_ptr(v7, bounds))
             gc_update_pointer_field(&p[7]);
 
         p += 8;
@@ -1100,17 +2048,13 @@ void gc_scan_range_conservative(void *start, size_t size)
         uintptr_t v2 = (uintptr_t)p[2];
         uintptr_t v3 = (uintptr_t)p[3];
 
-        if (v0 && gc_might_be_heap_ptr(v0, bounds) &&
-            gc_is_valid_object_start((void *)v0))
+        if (v0 && gc_might_be_heap_ptr(v0, bounds))
             gc_update_pointer_field(&p[0]);
-        if (v1 && gc_might_be_heap_ptr(v1, bounds) &&
-            gc_is_valid_object_start((void *)v1))
+        if (v1 && gc_might_be_heap_ptr(v1, bounds))
             gc_update_pointer_field(&p[1]);
-        if (v2 && gc_might_be_heap_ptr(v2, bounds) &&
-            gc_is_valid_object_start((void *)v2))
+        if (v2 && gc_might_be_heap_ptr(v2, bounds))
             gc_update_pointer_field(&p[2]);
-        if (v3 && gc_might_be_heap_ptr(v3, bounds) &&
-            gc_is_valid_object_start((void *)v3))
+        if (v3 && gc_might_be_heap_ptr(v3, bounds))
             gc_update_pointer_field(&p[3]);
 
         p += 4;
@@ -1120,12 +2064,316 @@ void gc_scan_range_conservative(void *start, size_t size)
     while (p < end)
     {
         uintptr_t v = (uintptr_t)*p;
-        if (v && gc_might_be_heap_ptr(v, bounds) &&
-            gc_is_valid_object_start((void *)v))
+        if (v && gc_might_be_heap_ptr(v, bounds))
             gc_update_pointer_field(p);
         p++;
     }
+    gc_conservative = false;
+}
+
+#if GC_MARK_COMPACT
+/* --- Mark-Compact Collection --- */
+
+/*
+ * Lisp-2 style sliding compaction over a single heap, so the whole heap
+ * holds live data instead of half of it. Objects keep their headers; the
+ * collector's state lives in side tables:
+ *
+ *   mark_map    one bit per 8-byte granule, set across every live object
+ *   block_live  live bytes below each 256-byte block (one mark_map word)
+ *
+ * An object's new address is then its block's live count plus the live
+ * granules below it in the same word, so forwarding needs no extra header
+ * word and no pass that writes one (Compressor-style). Compaction slides
+ * objects towards the heap base and keeps their order.
+ */
+
+/* Marked objects whose fields still need scanning */
+static gc_header_t **gc_mark_stack;
+static int gc_mark_count;
+static int gc_mark_capacity;
+
+/* Root slots rewritten once the update pass is over (see gc_compact) */
+typedef struct
+{
+    void **field;
+    void *value;
+} gc_fixup_t;
+
+static gc_fixup_t *gc_fixups;
+static int gc_fixup_count;
+static int gc_fixup_capacity;
+static bool gc_defer_updates;
+
+static void *gc_compact_grow(void *array, int *capacity, size_t elem_size)
+{
+    int new_capacity = *capacity ? *capacity * 2 : 256;
+    void *p = realloc(array, (size_t)new_capacity * elem_size);
+    if (!p)
+        runtime_throw("gc_compact: out of memory for mark stack");
+    *capacity = new_capacity;
+    return p;
+}
+
+/* SH-4 has no popcount instruction */
+static inline uint32_t popcount32(uint32_t v)
+{
+    v = v - ((v >> 1) & 0x55555555u);
+    v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+    v = (v + (v >> 4)) & 0x0F0F0F0Fu;
+    return (v * 0x01010101u) >> 24;
+}
+
+static inline size_t gc_granule(const void *p)
+{
+    return (size_t)((const uint8_t *)p - gc_heap.space[0]) / GC_ALIGN;
+}
+
+static inline bool gc_is_marked(gc_header_t *header)
+{
+    size_t g = gc_granule(header);
+    return (gc_heap.mark_map[g >> 5] >> (g & 31)) & 1;
+}
+
+/* Set the mark bits of every granule in [g, end) */
+static void gc_mark_granules(size_t g, size_t end)
+{
+    uint32_t *map = gc_heap.mark_map;
+
+    while (g < end && (g & 31))
+    {
+        map[g >> 5] |= 1u << (g & 31);
+        g++;
+    }
+    while (end - g >= 32)
+    {
+        map[g >> 5] = 0xFFFFFFFFu;
+        g += 32;
+    }
+    while (g < end)
+    {
+        map[g >> 5] |= 1u << (g & 31);
+        g++;
+    }
+}
+
+/* New address of a marked object's header */
+static inline uint8_t *gc_compact_forward(gc_header_t *header)
+{
+    size_t g = gc_granule(header);
+    uint32_t below = gc_heap.mark_map[g >> 5] & ((1u << (g & 31)) - 1);
+    return gc_heap.space[0] + gc_heap.block_live[g >> 5] + popcount32(below) * GC_ALIGN;
+}
+
+/* Header of the first marked object at or after p, or end */
+static uint8_t *gc_next_marked(uint8_t *p, uint8_t *end)
+{
+    if (p >= end)
+        return end;
+
+    size_t g = gc_granule(p);
+    size_t last = (gc_granule(end) - 1) >> 5;
+    size_t w = g >> 5;
+    uint32_t bits = gc_heap.mark_map[w] & (0xFFFFFFFFu << (g & 31));
+
+    while (bits == 0)
+    {
+        if (++w > last)
+            return end;
+        bits = gc_heap.mark_map[w];
+    }
+
+    uint8_t *next = gc_heap.space[0] + ((w << 5) + ctz32(bits)) * GC_ALIGN;
+    return next < end ? next : end;
+}
+
+static void gc_compact_pointer_field(void **field, gc_header_t *header)
+{
+    if (gc_compact_phase == GC_COMPACT_MARK)
+    {
+        if (gc_is_marked(header) || !gc_validate_header(header))
+            return;
+
+        size_t g = gc_granule(header);
+        gc_mark_granules(g, g + GC_HEADER_GET_SIZE(header) / GC_ALIGN);
+        if (!GC_HEADER_IS_NOSCAN(header))
+        {
+            if (gc_mark_count == gc_mark_capacity)
+                gc_mark_stack = gc_compact_grow(gc_mark_stack, &gc_mark_capacity,
+                                                sizeof(gc_header_t *));
+            gc_mark_stack[gc_mark_count++] = header;
+        }
+        return;
+    }
+
+    /* Rejected while marking (bad header): leave the value alone */
+    if (!gc_is_marked(header))
+        return;
+
+    void *new_ptr = gc_compact_forward(header) +
+                    ((uintptr_t)*field - (uintptr_t)header);
+
+    if (gc_defer_updates)
+    {
+        if (gc_fixup_count == gc_fixup_capacity)
+            gc_fixups = gc_compact_grow(gc_fixups, &gc_fixup_capacity,
+                                        sizeof(gc_fixup_t));
+        gc_fixups[gc_fixup_count].field = field;
+        gc_fixups[gc_fixup_count].value = new_ptr;
+        gc_fixup_count++;
+    }
+    else
+    {
+        *field = new_ptr;
+    }
+}
+
+/* Nursery objects are roots for compaction: it does not move them */
+static void gc_scan_nursery_objects(void)
+{
+    uint8_t *ptr = gc_heap.nursery;
+
+    while (ptr < gc_heap.nursery_ptr)
+    {
+        gc_header_t *header = (gc_header_t *)ptr;
+        size_t obj_size = GC_HEADER_GET_SIZE(header);
+        if (unlikely(obj_size < GC_HEADER_SIZE) ||
+            unlikely(obj_size & GC_ALIGN_MASK))
+            break;
+        gc_scan_object(gc_get_user_ptr(header));
+        ptr += obj_size;
+    }
+}
+
+/*
+ * Full collection in mark-compact mode. Runs inside gc_collect's pause:
+ *
+ *   1. Mark from the roots and nursery objects; sweep the pinned and
+ *      mature objects.
+ *   2. Sum live bytes per block (the forwarding table).
+ *   3. Rewrite every pointer into the heap: roots, marked heap objects,
+ *      nursery objects, pinned and mature objects.
+ *   4. Slide the marked objects down, rebuilding the object-start map.
+ *   5. Promote the nursery into the space just freed.
+ *
+ * A root slot can be visited more than once (an explicit root that is
+ * also a global, overlapping conservative ranges). Copying tolerates that
+ * because a second visit sees a to-space pointer, but forwarding an
+ * already-forwarded heap address would move it again, so root updates are
+ * logged and applied after the pass; duplicates then write the same value.
+ */
+static void gc_compact(void)
+{
+    uint8_t *heap = gc_heap.space[0];
+    uint8_t *old_end = gc_heap.alloc_ptr;
+
+    gc_from_count = 0;
+    gc_from_hull.lo = UINTPTR_MAX;
+    gc_from_hull.hi = 0;
+    gc_add_from_range((uintptr_t)heap, (uintptr_t)old_end);
+    gc_widen_hull_for_nonmoving();
+
+    /* 1. Mark */
+    gc_compact_phase = GC_COMPACT_MARK;
+    gc_mark_count = 0;
+    gc_pinned_begin_mark();
+    gc_mature_begin_mark();
+    gc_scan_roots();
+    gc_scan_nursery_objects();
+
+    void *obj;
+    do
+    {
+        while (gc_mark_count > 0)
+            gc_scan_object(gc_get_user_ptr(gc_mark_stack[--gc_mark_count]));
+        while ((obj = gc_pinned_pop_grey()) != NULL)
+            gc_scan_object(obj);
+        while ((obj = gc_mature_pop_grey()) != NULL)
+            gc_scan_object(obj);
+    } while (gc_mark_count > 0);
+
+    gc_pinned_sweep();
+    gc_mature_sweep();
+
+    /* 2. Forwarding table */
+    size_t words = (gc_granule(old_end) + 31) >> 5;
+    uint32_t live = 0;
+    for (size_t w = 0; w < words; w++)
+    {
+        gc_heap.block_live[w] = live;
+        live += popcount32(gc_heap.mark_map[w]) * GC_ALIGN;
+    }
+
+    /* 3. Update */
+    gc_compact_phase = GC_COMPACT_UPDATE;
+    gc_fixup_count = 0;
+    gc_defer_updates = true;
+    gc_scan_roots();
+    gc_defer_updates = false;
+
+    uint8_t *p;
+    for (p = gc_next_marked(heap, old_end); p < old_end;
+         p = gc_next_marked(p + GC_HEADER_GET_SIZE((gc_header_t *)p), old_end))
+        gc_scan_object(gc_get_user_ptr((gc_header_t *)p));
+
+    gc_scan_nursery_objects();
+    for (int i = 0; (obj = gc_pinned_object(i)) != NULL; i++)
+        gc_scan_object(obj);
+    if (gc_mature_size)
+        gc_mature_walk(gc_scan_object);
+
+    for (int i = 0; i < gc_fixup_count; i++)
+        *gc_fixups[i].field = gc_fixups[i].value;
+
+    /* 4. Slide. Destinations never pass the next source, so each memmove
+     * only overwrites objects that have already moved. */
+    uint32_t *start_map = gc_heap.start_map[0];
+    gc_start_map_clear(start_map, heap, heap, old_end);
+
+    uint8_t *dst = heap;
+    for (p = gc_next_marked(heap, old_end); p < old_end;)
+    {
+        size_t obj_size = GC_HEADER_GET_SIZE((gc_header_t *)p);
+        uint8_t *next = p + obj_size;
+
+        gc_pretenure_survivor(((gc_header_t *)p)->type, obj_size);
+        if (dst != p)
+        {
+            memmove(dst, p, obj_size);
+            gc_trace_objects++;
+            gc_trace_bytes += obj_size;
+        }
+        gc_start_map_set(start_map, gc_heap.start_back[0], heap, dst, obj_size);
+        dst += obj_size;
+        p = gc_next_marked(next, old_end);
+    }
+
+    gc_start_map_clear(gc_heap.mark_map, heap, heap, old_end);
+    gc_compact_phase = GC_COMPACT_OFF;
+
+    gc_heap.alloc_ptr = dst;
+    gc_heap.bytes_copied = dst - heap;
+    if (gc_heap.clean_from[0] < old_end)
+        gc_heap.clean_from[0] = old_end;
+
+    /* The freed tail is cached (slide reads, dead objects' writes), and
+     * promotion store-queue copies into it, bypassing the cache */
+    uintptr_t freed = (uintptr_t)dst & ~(uintptr_t)31;
+    if (freed < (uintptr_t)old_end)
+        dcache_purge_range(freed, (uintptr_t)old_end - freed);
+
+    /* 5. Promote. Remembered slots moved with their objects, so find the
+     * old-to-young pointers by scanning the compacted heap. */
+    if (gc_heap.nursery_ptr > gc_heap.nursery)
+    {
+        gc_remset.overflow = true;
+        gc_promote_nursery();
+    }
+    gc_reset_nursery();
+
+    gc_heap.bytes_allocated = gc_heap.alloc_ptr - heap;
 }
+#endif /* GC_MARK_COMPACT */
 
 /* --- Root Scanning --- */
 
@@ -1168,6 +2416,107 @@ static void gc_scan_compiler_roots(void)
 
 /* allgs_iterate and allgs_get_count declared in goroutine.h */
 
+static uint32_t gc_stacks_elided;
+
+#if GC_STACK_SLOT_CACHE
+/*
+ * Stack scan cache.
+ *
+ * A parked goroutine's stack only changes when it runs or when a waker
+ * writes into it (a channel send into a receiver's elem), and both clear
+ * gp->gc_stack_clean. While it stays set, the words that were not heap
+ * pointers at the last scan still are not, and the ones that were have
+ * only been forwarded by the collector. So the stack is covered by
+ * updating the remembered slots, and root scanning costs a full pass only
+ * for the goroutines that ran since the last collection.
+ *
+ * Slots are recorded against every heap region, not just this collection's
+ * from-space: a stack recorded during a minor GC still has to give up its
+ * old-space pointers to the next full one.
+ */
+static bool gc_scan_stack_cached(G *gp)
+{
+    if (!gp->gc_stack_clean)
+        return false;
+
+    void **sp = (void **)gp->context.sp;
+    for (uint32_t i = 0; i < gp->gc_stack_nslots; i++)
+        gc_update_pointer_field(&sp[gp->gc_stack_slots[i]]);
+
+    gc_stacks_elided++;
+    return true;
+}
+
+/* Any address a heap pointer can hold, whatever kind of collection runs */
+static inline bool gc_in_any_heap(uintptr_t v)
+{
+    if (gc_in_nursery((void *)v) || gc_maybe_pinned(v) || gc_in_mature((void *)v))
+        return true;
+    for (int i = 0; i < GC_SPACE_COUNT; i++)
+    {
+        if (v - (uintptr_t)gc_heap.space[i] < gc_heap.space_size)
+            return true;
+    }
+    return false;
+}
+
+/* Scan a single-segment stack from its saved SP, remembering the slots.
+ * Returns false if the stack needs the general scan. */
+static bool gc_scan_stack_recording(G *gp)
+{
+    stack_segment_t *seg = gp->stack;
+    if (seg == NULL || seg->prev != NULL || seg->sp_on_entry != NULL)
+        return false;
+
+    uintptr_t lo = (uintptr_t)seg->base;
+    uintptr_t hi = lo + seg->size;
+    uintptr_t sp = (uintptr_t)gp->context.sp;
+    if (sp < lo || sp > hi || (sp & (sizeof(void *) - 1)) ||
+        (hi - sp) / sizeof(void *) > UINT16_MAX)
+        return false;
+
+    if (!gp->gc_stack_slots)
+    {
+        gp->gc_stack_slots = (uint16_t *)malloc(GC_STACK_SLOT_CACHE * sizeof(uint16_t));
+        if (!gp->gc_stack_slots)
+            return false;
+    }
+
+    heap_bounds_t bounds = gc_from_hull;
+    void **base = (void **)sp;
+    uint32_t words = (hi - sp) / sizeof(void *);
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < words; i++)
+    {
+        uintptr_t v = (uintptr_t)base[i];
+        if (!v)
+            continue;
+
+        if (gc_in_any_heap(v))
+        {
+            if (n < GC_STACK_SLOT_CACHE)
+                gp->gc_stack_slots[n] = (uint16_t)i;
+            n++;
+        }
+        if (gc_might_be_heap_ptr(v, bounds))
+            gc_update_pointer_field(&base[i]);
+    }
+
+    /* Too many to remember: scan it in full every time */
+    gp->gc_stack_nslots = n <= GC_STACK_SLOT_CACHE ? n : 0;
+    gp->gc_stack_clean = n <= GC_STACK_SLOT_CACHE;
+    return true;
+}
+#endif
+
+/* Parked stacks updated from their cache rather than rescanned */
+uint32_t runtime_gcStacksElided(void) __asm__("_runtime.gcStacksElided");
+uint32_t runtime_gcStacksElided(void)
+{
+    return gc_stacks_elided;
+}
+
 /**
  * Scan a single goroutine's stack segments.
  *
@@ -1188,6 +2537,11 @@ static void gc_scan_goroutine_stack(G *gp)
     if (gp == NULL)
         return;
 
+#if GC_STACK_SLOT_CACHE
+    if (gc_scan_stack_cached(gp) || gc_scan_stack_recording(gp))
+        return;
+#endif
+
     /* Get goroutine's current stack segment from G struct */
     stack_segment_t *seg = gp->stack;
 
@@ -1270,6 +2624,36 @@ static void gc_scan_goroutine_stack(G *gp)
     }
 }
 
+/* Update the words of a C record named by its pointer map */
+static void gc_scan_ptrmap(void *record, uint64_t map)
+{
+    void **words = (void **)record;
+
+    for (int half = 0; half < 2; half++, words += 32)
+    {
+        uint32_t mask = (uint32_t)(map >> (32 * half));
+        while (mask)
+        {
+            gc_update_pointer_field(&words[ctz32(mask)]);
+            mask &= mask - 1;
+        }
+    }
+}
+
+/*
+ * A G's own pointer fields, and the sudogs it is parked on. Sudogs are
+ * malloc'd and reached from nowhere the collector traces, so their elem
+ * and channel are updated here. Defer, panic and checkpoint records are
+ * heap objects with their own pointer maps.
+ */
+static void gc_scan_g(G *gp)
+{
+    gc_scan_ptrmap(gp, G_GC_PTRMAP);
+
+    for (sudog *sg = gp->waiting; sg != NULL; sg = sg->waitlink)
+        gc_scan_ptrmap(sg, SUDOG_GC_PTRMAP);
+}
+
 /*
  * Scan all goroutine stacks.
  *
@@ -1316,7 +2700,7 @@ static void gc_scan_all_goroutine_stacks(void)
         if (gp == current)
         {
             // Still scan the G struct itself for pointers
-            gc_scan_range_conservative(gp, sizeof(G));
+            gc_scan_g(gp);
             continue;
         }
 
@@ -1325,7 +2709,7 @@ static void gc_scan_all_goroutine_stacks(void)
         count++;
 
         // Also scan the G struct itself for pointers (defer chain, panic, etc.)
-        gc_scan_range_conservative(gp, sizeof(G));
+        gc_scan_g(gp);
     }
 }
 
@@ -1335,6 +2719,7 @@ static void gc_scan_all_goroutine_stacks(void)
  */
 static void gc_scan_roots(void)
 {
+    uint64_t clock = timer_us_gettime64();
 
     // Scan explicit roots (gc_add_root)
     for (int i = 0; i < gc_root_table.count; i++)
@@ -1346,15 +2731,24 @@ static void gc_scan_roots(void)
         }
     }
 
+    // Frame arena objects never move but may point into the heap
+    gc_arena_scan(gc_scan_object, gc_minor_roots);
+
+    // Pooled objects (runtime.PoolPut) and the pools' victims
+    gc_pool_scan(gc_update_pointer_field);
+    gc_trace_phase(GC_PHASE_ROOTS, &clock);
+
     // Scan compiler-registered roots (registerGCRoots)
     // This provides PRECISE type information - no conservative fallback needed
     gc_scan_compiler_roots();
+    gc_trace_phase(GC_PHASE_GLOBALS, &clock);
 
     // Scan current stack (main goroutine or current goroutine)
     gc_scan_stack();
 
     // Scan all goroutine stacks
     gc_scan_all_goroutine_stacks();
+    gc_trace_phase(GC_PHASE_STACKS, &clock);
 }
 
 /*
@@ -1408,3 +2802,26 @@ static void gc_scan_stack(void)
 
     gc_scan_range_conservative(sp, stack_size);
 }
+
+/* --- Heap Walking --- */
+
+/* Visit every root slot the collector scans. Read-only: call it with
+ * collection inhibited or not allocating, so nothing moves meanwhile. */
+void gc_walk_roots(void (*visit)(void **field))
+{
+    save_stack_bounds();
+    gc_set_from_ranges(gc_heap.space[gc_heap.active_space]);
+    gc_walk_visit = visit;
+    gc_scan_roots();
+    gc_walk_visit = NULL;
+    gc_stack_bounds_valid = false;
+}
+
+/* Visit the pointer fields of one object, found as a collection would */
+void gc_walk_object(void *obj, void (*visit)(void **field))
+{
+    gc_set_from_ranges(gc_heap.space[gc_heap.active_space]);
+    gc_walk_visit = visit;
+    gc_scan_object(obj);
+    gc_walk_visit = NULL;
+}
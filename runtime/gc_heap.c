@@ -1,11 +1,13 @@
 #include "gc_semispace.h"
 #include "type_descriptors.h"
+#include "runtime.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <inttypes.h>
 #include <malloc.h>
 #include <arch/cache.h>
+#include <arch/irq.h>
 #include <kos/dbglog.h>
 
 gc_heap_t gc_heap = {
@@ -14,7 +16,7 @@ gc_heap_t gc_heap = {
     .alloc_ptr = NULL,
     .alloc_limit = NULL,
     .scan_ptr = NULL,
-    .space_size = GC_SEMISPACE_SIZE,
+    .space_size = GC_SPACE_SIZE,
     .bytes_allocated = 0,
     .total_bytes_allocated = 0,
     .total_alloc_count = 0,
@@ -34,33 +36,96 @@ void gc_init(void)
     if (gc_heap.initialized)
         return;
 
-    gc_heap.space[0] = (uint8_t *)memalign(32, GC_SEMISPACE_SIZE);
-    gc_heap.space[1] = (uint8_t *)memalign(32, GC_SEMISPACE_SIZE);
+    /* gc_heap_resize() may have changed the size before init */
+    size_t space_size = gc_heap.space_size;
+    bool failed = false;
 
-    if (!gc_heap.space[0] || !gc_heap.space[1])
+    for (int i = 0; i < GC_SPACE_COUNT; i++)
     {
-        if (gc_heap.space[0])
-            free(gc_heap.space[0]);
-        if (gc_heap.space[1])
-            free(gc_heap.space[1]);
-        gc_heap.space[0] = NULL;
-        gc_heap.space[1] = NULL;
+        gc_heap.space[i] = (uint8_t *)memalign(32, space_size);
+        gc_heap.start_map[i] = (uint32_t *)memalign(32, GC_START_MAP_BYTES(space_size));
+        gc_heap.start_back[i] = (uint16_t *)memalign(32, GC_START_BACK_BYTES(space_size));
+        gc_heap.card_map[i] = (uint32_t *)memalign(32, GC_CARD_MAP_BYTES(space_size));
+        gc_heap.space_capacity[i] = space_size;
+        failed |= !gc_heap.space[i] || !gc_heap.start_map[i] || !gc_heap.start_back[i] ||
+                  !gc_heap.card_map[i];
+    }
+    gc_heap.nursery = (uint8_t *)memalign(32, GC_NURSERY_SIZE);
+    gc_heap.nursery_start_map = (uint32_t *)memalign(32, GC_START_MAP_BYTES(GC_NURSERY_SIZE));
+    gc_heap.nursery_start_back = (uint16_t *)memalign(32, GC_START_BACK_BYTES(GC_NURSERY_SIZE));
+    gc_heap.nursery_card_map = (uint32_t *)memalign(32, GC_CARD_MAP_BYTES(GC_NURSERY_SIZE));
+    failed |= !gc_heap.nursery || !gc_heap.nursery_start_map || !gc_heap.nursery_start_back ||
+              !gc_heap.nursery_card_map;
+#if GC_MARK_COMPACT
+    /* Mark bits and per-block live counts both need one word per 256 bytes */
+    gc_heap.mark_map = (uint32_t *)memalign(32, GC_START_MAP_BYTES(space_size));
+    gc_heap.block_live = (uint32_t *)memalign(32, GC_START_MAP_BYTES(space_size));
+    failed |= !gc_heap.mark_map || !gc_heap.block_live;
+#endif
+
+    if (failed)
+    {
+        /* free(NULL) is a no-op */
+        for (int i = 0; i < GC_SPACE_COUNT; i++)
+        {
+            free(gc_heap.space[i]);
+            free(gc_heap.start_map[i]);
+            free(gc_heap.start_back[i]);
+            free(gc_heap.card_map[i]);
+            gc_heap.space[i] = NULL;
+            gc_heap.start_map[i] = NULL;
+            gc_heap.start_back[i] = NULL;
+            gc_heap.card_map[i] = NULL;
+        }
+        free(gc_heap.nursery);
+        free(gc_heap.nursery_start_map);
+        free(gc_heap.nursery_start_back);
+        free(gc_heap.nursery_card_map);
+        gc_heap.nursery = NULL;
+        gc_heap.nursery_start_map = NULL;
+        gc_heap.nursery_start_back = NULL;
+        gc_heap.nursery_card_map = NULL;
+#if GC_MARK_COMPACT
+        free(gc_heap.mark_map);
+        free(gc_heap.block_live);
+        gc_heap.mark_map = NULL;
+        gc_heap.block_live = NULL;
+#endif
         runtime_throw("gc_init: alloc failed");
     }
 
-    memset(gc_heap.space[0], 0, GC_SEMISPACE_SIZE);
-    memset(gc_heap.space[1], 0, GC_SEMISPACE_SIZE);
+    for (int i = 0; i < GC_SPACE_COUNT; i++)
+    {
+        memset(gc_heap.space[i], 0, space_size);
+        memset(gc_heap.start_map[i], 0, GC_START_MAP_BYTES(space_size));
+        memset(gc_heap.start_back[i], 0, GC_START_BACK_BYTES(space_size));
+    }
+    memset(gc_heap.nursery, 0, GC_NURSERY_SIZE);
+    memset(gc_heap.nursery_start_map, 0, GC_START_MAP_BYTES(GC_NURSERY_SIZE));
+    memset(gc_heap.nursery_start_back, 0, GC_START_BACK_BYTES(GC_NURSERY_SIZE));
+#if GC_MARK_COMPACT
+    memset(gc_heap.mark_map, 0, GC_START_MAP_BYTES(space_size));
+#endif
+
+    gc_heap.nursery_ptr = gc_heap.nursery;
+    gc_heap.nursery_clean_from = gc_heap.nursery;
+    for (int i = 0; i < GC_SPACE_COUNT; i++)
+        gc_heap.clean_from[i] = gc_heap.space[i];
+    gc_heap.nursery_limit = gc_heap.nursery + GC_NURSERY_SIZE;
+    gc_heap.nursery_size = GC_NURSERY_SIZE;
 
     gc_heap.active_space = 0;
     gc_heap.alloc_ptr = gc_heap.space[0];
-    gc_heap.alloc_limit = gc_heap.space[0] + GC_SEMISPACE_SIZE;
+    gc_heap.alloc_limit = gc_heap.space[0] + space_size;
     gc_heap.scan_ptr = gc_heap.space[0];
-    gc_heap.space_size = GC_SEMISPACE_SIZE;
     gc_heap.bytes_allocated = 0;
     gc_heap.bytes_copied = 0;
     gc_heap.gc_count = 0;
     gc_heap.initialized = true;
     gc_heap.gc_in_progress = false;
+    gc_heap.incremental = GC_INCREMENTAL;
+    gc_heap.cycle_active = false;
+    gc_heap.depth_first = GC_COPY_DEPTH_FIRST;
 }
 
 static inline size_t gc_align_size(size_t size)
@@ -68,7 +133,154 @@ static inline size_t gc_align_size(size_t size)
     return (size + GC_ALIGN_MASK) & ~GC_ALIGN_MASK;
 }
 
-void *gc_alloc(size_t size, struct __go_type_descriptor *type)
+/* Fill in the header and, if zero is set, the payload of a freshly
+ * bumped object. */
+static inline void *gc_init_object(gc_header_t *header, size_t total_size,
+                                   struct __go_type_descriptor *type, bool noscan,
+                                   bool zero)
+{
+    gc_heap.bytes_allocated += total_size;
+    gc_heap.total_bytes_allocated += total_size;
+    gc_heap.total_alloc_count++;
+
+    uint8_t type_tag = type ? (type->__code & GC_KIND_MASK) : 0;
+    GC_HEADER_SET(header, type_tag, total_size);
+    header->type = type;
+
+    if (noscan)
+        GC_HEADER_SET_NOSCAN(header);
+
+    void *user_ptr = gc_get_user_ptr(header);
+    if (zero)
+        memset(user_ptr, 0, total_size - GC_HEADER_SIZE);
+    return user_ptr;
+}
+
+/* Clear the start bits for [lo, hi) of the space at base */
+void gc_start_map_clear(uint32_t *map, const uint8_t *base,
+                        const uint8_t *lo, const uint8_t *hi)
+{
+    size_t g = (size_t)(lo - base) / GC_ALIGN;
+    size_t end = (size_t)(hi - base + GC_ALIGN - 1) / GC_ALIGN;
+
+    while (g < end && (g & 31))
+    {
+        map[g >> 5] &= ~(1u << (g & 31));
+        g++;
+    }
+
+    size_t words = (end - g) >> 5;
+    if (words)
+    {
+        memset(&map[g >> 5], 0, words * sizeof(uint32_t));
+        g += words << 5;
+    }
+
+    while (g < end)
+    {
+        map[g >> 5] &= ~(1u << (g & 31));
+        g++;
+    }
+}
+
+/* Whether a bumped object at obj must be cleared: only if the caller
+ * needs zeroed memory and it lies below clean_from. Memory above was
+ * pre-zeroed (gc_prezero_incremental), and the bump pointer has already
+ * moved past the object, so a vblank step cannot clear it under us. */
+static inline bool gc_needs_zero(const void *obj, uint8_t *const *clean_from,
+                                 bool needzero)
+{
+    __asm__ volatile("" : : : "memory"); /* Bump before header stores */
+    return needzero && (const uint8_t *)obj < *clean_from;
+}
+
+/* Turn the nursery object at header into a small-object page for slots
+ * of slot_size bytes and make it the current page for that size. */
+static void gc_small_page_init(gc_header_t *header, size_t slot_size)
+{
+    gc_heap.bytes_allocated += GC_SMALL_PAGE_SIZE;
+
+    GC_HEADER_SET(header, GC_TAG_SMALL_PAGE, GC_SMALL_PAGE_SIZE);
+    header->type = NULL;
+    GC_HEADER_SET_NOSCAN(header);
+
+    gc_small_page_t *page = gc_get_user_ptr(header);
+    memset(page, 0, sizeof(*page));
+    page->slot_size = slot_size;
+    page->capacity = (GC_SMALL_PAGE_SIZE - GC_HEADER_SIZE - sizeof(*page)) / slot_size;
+
+    gc_heap.small_page[slot_size / GC_ALIGN - 1] = page;
+    gc_heap.small_pages++;
+}
+
+/* Next slot of the current page for aligned_size, or NULL if it is full */
+static inline void *gc_small_alloc(size_t aligned_size, bool needzero)
+{
+    gc_small_page_t *page = gc_heap.small_page[aligned_size / GC_ALIGN - 1];
+    if (page == NULL || page->used == page->capacity)
+        return NULL;
+
+    uint8_t *slot = gc_small_slots(page) + page->used++ * aligned_size;
+    gc_heap.total_bytes_allocated += aligned_size;
+    gc_heap.total_alloc_count++;
+
+    if (gc_needs_zero(slot, &gc_heap.nursery_clean_from, needzero))
+        memset(slot, 0, aligned_size);
+    return slot;
+}
+
+/* Bump-allocate in the semispace. The object is remembered for the next
+ * minor GC since it may be initialized with nursery pointers. */
+static inline void *gc_alloc_old(size_t total_size, struct __go_type_descriptor *type,
+                                 bool noscan, bool needzero)
+{
+    uint8_t *const *clean_from = &gc_heap.clean_from[gc_heap.active_space];
+
+    /* During an incremental cycle [alloc_ptr, alloc_limit) is the grey
+     * region's growth room. Take space from the top instead; the cycle's
+     * finish evacuates these objects like from-space. */
+    if (unlikely(gc_heap.cycle_active))
+    {
+        int old_irq = irq_disable(); /* a vblank step reads alloc_limit */
+        gc_heap.alloc_limit -= total_size;
+        gc_header_t *header = (gc_header_t *)gc_heap.alloc_limit;
+        irq_restore(old_irq);
+        gc_start_map_set(gc_heap.start_map[gc_heap.active_space],
+                         gc_heap.start_back[gc_heap.active_space],
+                         gc_heap.space[gc_heap.active_space], header, total_size);
+        return gc_init_object(header, total_size, type, noscan,
+                              gc_needs_zero(header, clean_from, needzero));
+    }
+
+    gc_header_t *header = (gc_header_t *)gc_heap.alloc_ptr;
+    gc_heap.alloc_ptr += total_size;
+    gc_start_map_set(gc_heap.start_map[gc_heap.active_space],
+                     gc_heap.start_back[gc_heap.active_space],
+                     gc_heap.space[gc_heap.active_space], header, total_size);
+
+    void *user_ptr = gc_init_object(header, total_size, type, noscan,
+                                    gc_needs_zero(header, clean_from, needzero));
+    if (!GC_HEADER_IS_NOSCAN(header))
+        gc_remember((uintptr_t)user_ptr | GC_REMSET_OBJECT);
+    return user_ptr;
+}
+
+/* Run a full collection if the semispace is past its trigger. */
+static void gc_check_old_trigger(void)
+{
+    size_t used = gc_heap.alloc_ptr - gc_heap.space[gc_heap.active_space];
+
+    if (used > gc_pacer_trigger())
+    {
+        if (gc_heap.incremental && !gc_heap.cycle_active)
+            gc_collect_start();
+        else
+            gc_collect();
+    }
+}
+
+static inline void *gc_alloc_common(size_t size, struct __go_type_descriptor *type,
+                                    bool noscan, bool needzero)
 {
     if (!gc_heap.initialized)
         gc_init();
@@ -83,12 +295,34 @@ void *gc_alloc(size_t size, struct __go_type_descriptor *type)
     if (size == 0)
         return gc_zerobase;
 
-    /* Large objects bypass GC heap */
+    /* Allocation is a safe point for moving the goroutine's stack */
+    if (unlikely(goroutine_stack_low()))
+        goroutine_morestack();
+
+    if (unlikely(size >= gc_profile_countdown))
+        gc_profile_sample(size, type);
+    else
+        gc_profile_countdown -= size;
+
+    /* Inside a frame arena scope the arena comes first */
+    G *gp = current_g;
+    if (unlikely(gp != NULL && gp->arena != NULL))
+    {
+        void *arena_ptr = gc_arena_alloc(gp->arena, size, type, noscan, needzero);
+        if (arena_ptr != NULL)
+            return arena_ptr;
+    }
+
+    /* Large objects go to the non-moving large object space */
     if (size > GC_LARGE_OBJECT_THRESHOLD)
+        return gc_alloc_large(size, type, noscan);
+
+    /* Types whose objects keep surviving go straight to the mature region */
+    if (unlikely(gc_pretenure_hit(type)))
     {
-        gc_heap.large_alloc_count++;
-        gc_heap.large_alloc_total += size;
-        return gc_external_alloc(size);
+        void *mature_ptr = gc_pretenure_alloc(size, type, noscan, needzero);
+        if (mature_ptr != NULL)
+            return mature_ptr;
     }
 
     size_t aligned_size = gc_align_size(size);
@@ -100,45 +334,89 @@ void *gc_alloc(size_t size, struct __go_type_descriptor *type)
     /* gc_percent < 0 disables automatic GC (only explicit runtime.GC()) */
     bool gc_allowed = (gc_inhibit_count == 0) && (gc_percent >= 0);
 
-    if (gc_allowed && !gc_heap.gc_in_progress)
+    /* Small pointer-free objects take a headerless slot. When the current
+     * page is full, a new one is bumped from the nursery below. */
+    bool small = noscan && aligned_size <= GC_SMALL_MAX_SIZE;
+    if (small)
     {
-        size_t used = gc_heap.alloc_ptr - gc_heap.space[gc_heap.active_space];
-        /* Threshold based on gc_percent (default 100 = 75% of heap) */
-        size_t threshold = (gc_heap.space_size * 3) / 4;
-        if (gc_percent > 0 && gc_percent != 100)
-            threshold = gc_heap.space_size * (size_t)gc_percent / 100;
+        void *slot = gc_small_alloc(aligned_size, needzero);
+        if (likely(slot != NULL))
+            return slot;
+    }
+    size_t nursery_size = small ? GC_SMALL_PAGE_SIZE : total_size;
 
-        if (used > threshold)
-            gc_collect();
+    /* Fast path: bump-allocate in the nursery */
+    if (likely(nursery_size <= GC_NURSERY_MAX_OBJECT))
+    {
+        if (unlikely(gc_heap.nursery_ptr + nursery_size > gc_heap.nursery_limit) &&
+            gc_allowed && !gc_heap.gc_in_progress)
+        {
+            gc_minor_collect();
+            gc_check_old_trigger();
+        }
+
+        if (likely(gc_heap.nursery_ptr + nursery_size <= gc_heap.nursery_limit))
+        {
+            gc_header_t *header = (gc_header_t *)gc_heap.nursery_ptr;
+            gc_heap.nursery_ptr += nursery_size;
+            gc_start_map_set(gc_heap.nursery_start_map, gc_heap.nursery_start_back,
+                             gc_heap.nursery, header, nursery_size);
+            if (small)
+            {
+                gc_small_page_init(header, aligned_size);
+                return gc_small_alloc(aligned_size, needzero);
+            }
+            return gc_init_object(header, total_size, type, noscan,
+                                  gc_needs_zero(header, &gc_heap.nursery_clean_from, needzero));
+        }
+
+        /* Nursery full and collection disabled - use the semispace */
     }
 
+    if (gc_allowed && !gc_heap.gc_in_progress)
+        gc_check_old_trigger();
+
     if (gc_heap.alloc_ptr + total_size > gc_heap.alloc_limit)
     {
         /* Must collect even if disabled - we're out of space */
         if (gc_inhibit_count == 0)
             gc_collect();
+        /* Let caches drop what they hold, and grow if allowed */
+        if (gc_heap.alloc_ptr + total_size > gc_heap.alloc_limit && gc_inhibit_count == 0)
+            gc_heap_exhausted(total_size);
         if (gc_heap.alloc_ptr + total_size > gc_heap.alloc_limit)
             runtime_throw("out of memory");
     }
 
-    gc_header_t *header = (gc_header_t *)gc_heap.alloc_ptr;
-    gc_heap.alloc_ptr += total_size;
-    gc_heap.bytes_allocated += total_size;
-    gc_heap.total_bytes_allocated += total_size;
-    gc_heap.total_alloc_count++;
+    return gc_alloc_old(total_size, type, noscan, needzero);
+}
 
-    uint8_t type_tag = type ? (type->__code & GC_KIND_MASK) : 0;
-    GC_HEADER_SET(header, type_tag, total_size);
-    header->type = type;
+/* NOSCAN only if the type is known and has no pointers */
+static inline bool gc_type_noscan(struct __go_type_descriptor *type)
+{
+    return type != NULL && type->__ptrdata == 0;
+}
 
-    /* NOSCAN only if type is known and has no pointers */
-    bool noscan = (type != NULL) && (type->__ptrdata == 0);
-    if (noscan)
-        GC_HEADER_SET_NOSCAN(header);
+void *gc_alloc(size_t size, struct __go_type_descriptor *type)
+{
+    return gc_alloc_common(size, type, gc_type_noscan(type), true);
+}
 
-    void *user_ptr = gc_get_user_ptr(header);
-    memset(user_ptr, 0, aligned_size);
-    return user_ptr;
+/* Like gc_alloc, but the caller initializes every byte itself (the
+ * compiler's needzero=false), so pre-zeroed memory needs no clearing and
+ * dirty memory is left as is. Only pointer-free objects qualify: stale
+ * words in a scanned object would be taken for pointers. */
+void *gc_alloc_nozero(size_t size, struct __go_type_descriptor *type)
+{
+    bool noscan = gc_type_noscan(type);
+    return gc_alloc_common(size, type, noscan, !noscan);
+}
+
+/* Untyped but pointer-free: unlike gc_alloc(size, NULL), which is scanned
+ * conservatively, the object is NOSCAN and may take a small-object slot. */
+void *gc_alloc_noscan(size_t size)
+{
+    return gc_alloc_common(size, NULL, true, true);
 }
 
 /* Allocate without triggering GC - for use during GC or panic */
@@ -160,23 +438,7 @@ void *gc_alloc_no_gc(size_t size, struct __go_type_descriptor *type)
     if (gc_heap.alloc_ptr + total_size > gc_heap.alloc_limit)
         runtime_throw("gc_alloc_no_gc: OOM");
 
-    gc_header_t *header = (gc_header_t *)gc_heap.alloc_ptr;
-    gc_heap.alloc_ptr += total_size;
-    gc_heap.bytes_allocated += total_size;
-    gc_heap.total_bytes_allocated += total_size;
-    gc_heap.total_alloc_count++;
-
-    uint8_t type_tag = type ? (type->__code & GC_KIND_MASK) : 0;
-    GC_HEADER_SET(header, type_tag, total_size);
-    header->type = type;
-
-    bool noscan = (type != NULL) && (type->__ptrdata == 0);
-    if (noscan)
-        GC_HEADER_SET_NOSCAN(header);
-
-    void *user_ptr = gc_get_user_ptr(header);
-    memset(user_ptr, 0, aligned_size);
-    return user_ptr;
+    return gc_alloc_old(total_size, type, gc_type_noscan(type), true);
 }
 
 void registerGCRoots(gc_root_list_t *roots)
@@ -240,11 +502,13 @@ void *gc_external_alloc(size_t size)
 
 void gc_external_free(void *ptr)
 {
-    if (ptr)
+    /* Large objects from gc_alloc are in the large object space */
+    if (ptr && !gc_pinned_free(ptr))
         free(ptr);
 }
 
-/* Exposed to Go as runtime.FreeExternal for freeing large allocations */
+/* Exposed to Go as runtime.FreeExternal. Large objects are collected
+ * automatically; this releases one early. */
 void runtime_FreeExternal(void *ptr) __asm__("_runtime.FreeExternal");
 void runtime_FreeExternal(void *ptr)
 {
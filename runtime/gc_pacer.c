@@ -0,0 +1,184 @@
+/* libgodc/runtime/gc_pacer.c - Full collection pacing
+ *
+ * The fixed trigger (75% of the semispace, or gc_percent of it) fires
+ * wherever the allocation that crosses it happens to be, usually mid-frame.
+ * The pacer moves that decision to frame boundaries: a game that calls
+ * runtime.GCFrameEnd() once per frame gets its collection there as soon as
+ * the heap is within two frames' growth of the trigger, and the pause is
+ * budgeted from what earlier collections cost:
+ *
+ *   predicted pause = live bytes (bytes_copied) x measured us per KB
+ *
+ * If the prediction fits the pause budget the boundary runs a full
+ * collection, otherwise an incremental cycle that later boundaries advance
+ * by one budget each. The fixed trigger stays as the backstop for frames
+ * that allocate more than predicted, and for games that never call
+ * GCFrameEnd.
+ *
+ * A heap goal (runtime.SetGCHeapGoal) or memory limit (gc_resize.c)
+ * lowers the trigger to keep the semispace in use near that size, but
+ * never below the live heap plus GC_PACER_MIN_HEADROOM of room to allocate.
+ */
+
+#include "gc_semispace.h"
+#include "runtime.h"
+
+/* Smallest trigger headroom above the live heap, as a fraction of the space */
+#define GC_PACER_MIN_HEADROOM(space) ((space) / 16)
+
+/* Frames of growth to leave below the trigger */
+#define GC_PACER_FRAMES_AHEAD 2
+
+static struct
+{
+    uint32_t pause_budget_us;
+    size_t heap_goal;        /* 0 = none */
+    size_t live;             /* Semispace in use after the last full GC */
+    uint32_t us_per_kb_x16;  /* Full pause per KB live, 1/16 us, smoothed */
+    size_t frame_growth;     /* Semispace growth per frame, smoothed */
+    size_t frame_used;       /* In use at the previous frame boundary */
+    uint32_t frame_gc_count; /* gc_count at the previous frame boundary */
+} pacer = {.pause_budget_us = GC_PAUSE_BUDGET_US, .heap_goal = GC_HEAP_GOAL_KB * 1024};
+
+static inline size_t semispace_used(void)
+{
+    return (size_t)(gc_heap.alloc_ptr - gc_heap.space[gc_heap.active_space]);
+}
+
+size_t gc_pacer_trigger(void)
+{
+    extern int32_t gc_percent; /* From gc_runtime.c */
+
+    /* Threshold based on gc_percent (default 100 = 75% of heap) */
+    size_t trigger = (gc_heap.space_size * 3) / 4;
+    if (gc_percent > 0 && gc_percent != 100)
+        trigger = gc_heap.space_size * (size_t)gc_percent / 100;
+
+    /* The memory limit is a goal too; the lower one wins */
+    size_t goal = gc_memlimit_goal();
+    if (pacer.heap_goal && pacer.heap_goal < goal)
+        goal = pacer.heap_goal;
+
+    if (goal < trigger)
+    {
+        size_t floor = pacer.live + GC_PACER_MIN_HEADROOM(gc_heap.space_size);
+        trigger = goal > floor ? goal : floor;
+    }
+    return trigger;
+}
+
+/* Where a frame boundary collects: room for the next frames' growth, but
+ * at least halfway from the live heap to the trigger */
+static size_t gc_pacer_soft_trigger(void)
+{
+    size_t trigger = gc_pacer_trigger();
+    size_t ahead = GC_PACER_FRAMES_AHEAD * pacer.frame_growth;
+    size_t half = pacer.live < trigger ? pacer.live + (trigger - pacer.live) / 2 : trigger;
+
+    if (ahead >= trigger || trigger - ahead < half)
+        return half;
+    return trigger - ahead;
+}
+
+uint32_t gc_pacer_predict_pause(void)
+{
+    return (uint32_t)(((uint64_t)pacer.live / 1024 * pacer.us_per_kb_x16) / 16);
+}
+
+/* Called after each full collection and incremental finish */
+void gc_pacer_collected(gc_trace_kind_t kind)
+{
+    pacer.live = semispace_used();
+
+    /* Only a full pause scales with the live heap */
+    if (kind != GC_TRACE_FULL || pacer.live < 1024)
+        return;
+
+    uint32_t sample = (uint32_t)((gc_heap.last_pause_us * 16 * 1024) / pacer.live);
+    if (pacer.us_per_kb_x16 == 0)
+        pacer.us_per_kb_x16 = sample;
+    else
+        pacer.us_per_kb_x16 = (pacer.us_per_kb_x16 * 3 + sample) / 4;
+}
+
+bool gc_pacer_frame_end(void)
+{
+    extern volatile int gc_inhibit_count;
+    extern int32_t gc_percent;
+
+    if (!gc_heap.initialized)
+        return false;
+
+    size_t used = semispace_used();
+
+    /* Growth is only meaningful if no full collection ran this frame */
+    if (gc_heap.gc_count == pacer.frame_gc_count && used >= pacer.frame_used)
+    {
+        size_t growth = used - pacer.frame_used;
+        if (pacer.frame_growth == 0)
+            pacer.frame_growth = growth;
+        else
+            pacer.frame_growth = (pacer.frame_growth * 3 + growth) / 4;
+    }
+
+    bool collected = false;
+    if (gc_percent >= 0 && gc_inhibit_count == 0 && !gc_heap.gc_in_progress)
+    {
+        if (gc_heap.cycle_active)
+        {
+            gc_collect_step(pacer.pause_budget_us);
+            collected = true;
+        }
+        else if (used >= gc_pacer_soft_trigger())
+        {
+            if (gc_pacer_predict_pause() <= pacer.pause_budget_us)
+            {
+                gc_collect();
+            }
+            else
+            {
+                /* Spread over the next frames (mark-compact: full GC) */
+                gc_collect_start();
+                if (gc_heap.cycle_active)
+                    gc_collect_step(pacer.pause_budget_us);
+            }
+            collected = true;
+        }
+    }
+
+    pacer.frame_used = semispace_used();
+    pacer.frame_gc_count = gc_heap.gc_count;
+    return collected;
+}
+
+/* runtime.GCFrameEnd - call once per frame, after rendering is submitted.
+ * Returns true if it collected or advanced a cycle. */
+bool runtime_GCFrameEnd(void) __asm__("_runtime.GCFrameEnd");
+bool runtime_GCFrameEnd(void)
+{
+    return gc_pacer_frame_end();
+}
+
+/* runtime.SetGCPauseBudget - longest full pause, in microseconds, that a
+ * frame boundary may take. Returns the previous budget. */
+int32_t runtime_SetGCPauseBudget(int32_t us) __asm__("_runtime.SetGCPauseBudget");
+int32_t runtime_SetGCPauseBudget(int32_t us)
+{
+    int32_t old = (int32_t)pacer.pause_budget_us;
+    if (us <= 0)
+        runtime_panicstring("SetGCPauseBudget: budget must be positive");
+    pacer.pause_budget_us = (uint32_t)us;
+    return old;
+}
+
+/* runtime.SetGCHeapGoal - semispace bytes in use to collect at, 0 for the
+ * gc_percent trigger alone. Returns the previous goal. */
+intptr_t runtime_SetGCHeapGoal(intptr_t bytes) __asm__("_runtime.SetGCHeapGoal");
+intptr_t runtime_SetGCHeapGoal(intptr_t bytes)
+{
+    intptr_t old = (intptr_t)pacer.heap_goal;
+    if (bytes < 0)
+        runtime_panicstring("SetGCHeapGoal: negative goal");
+    pacer.heap_goal = (size_t)bytes;
+    return old;
+}
@@ -0,0 +1,336 @@
+/* libgodc/runtime/gc_pinned.c - Non-moving (pinned) objects
+ *
+ * Pinned objects live outside the semispaces in memory from KOS malloc and
+ * never move, so their addresses can be handed to DMA (PVR, AICA, maple)
+ * or used as store queue targets. They carry a normal GC header and are
+ * reclaimed by mark-sweep alongside the copying collector: a full GC marks
+ * the pinned objects it reaches, scans their fields, and frees the rest.
+ *
+ * Objects above GC_LARGE_OBJECT_THRESHOLD use the same table (the large
+ * object space): copying them would cost more than it saves.
+ *
+ * The table is sorted by address so the collector can map any pointer,
+ * including an interior one, to its object with a binary search.
+ */
+
+#include "gc_semispace.h"
+#include "type_descriptors.h"
+#include "runtime.h"
+#include <string.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <arch/irq.h>
+
+/* User data is aligned for DMA and store queue bursts */
+#define GC_PINNED_ALIGN 32
+
+typedef struct
+{
+    uint8_t *obj;  /* User pointer (header sits just below) */
+    size_t size;   /* User size in bytes */
+    void *raw;     /* Block returned by memalign, for free() */
+    bool marked;   /* Reached during the current full collection */
+    bool large;    /* Counted in gc_heap.large_alloc_* */
+} gc_pinned_entry_t;
+
+static gc_pinned_entry_t *pinned_table;
+static int pinned_count;
+static int pinned_capacity;
+
+/* Marked objects whose fields still need scanning. An entry is pushed at
+ * most once per mark, so this is kept as large as pinned_table and never
+ * grows while marking, which may run in the vblank IRQ (no malloc). */
+static void **pinned_grey;
+static int pinned_grey_count;
+
+static bool pinned_marking;
+
+/* Large object bytes allocated since the last full collection */
+static size_t large_since_gc;
+
+uintptr_t gc_pinned_lo;
+uintptr_t gc_pinned_hi;
+size_t gc_pinned_bytes;
+
+static void *grow_array(void *array, int *capacity, size_t elem_size)
+{
+    int new_capacity = *capacity ? *capacity * 2 : 32;
+    void *p = realloc(array, (size_t)new_capacity * elem_size);
+    if (!p)
+        runtime_throw("gc pinned table: out of memory");
+    *capacity = new_capacity;
+    return p;
+}
+
+static void pinned_push_grey(void *obj)
+{
+    pinned_grey[pinned_grey_count++] = obj;
+}
+
+static void pinned_update_bounds(void)
+{
+    gc_pinned_lo = 0;
+    gc_pinned_hi = 0;
+    if (pinned_count > 0)
+    {
+        gc_pinned_entry_t *last = &pinned_table[pinned_count - 1];
+        gc_pinned_lo = (uintptr_t)pinned_table[0].obj;
+        gc_pinned_hi = (uintptr_t)last->obj + last->size;
+    }
+}
+
+/* Index of the entry containing addr, or -1 */
+static int pinned_find(uintptr_t addr)
+{
+    int lo = 0, hi = pinned_count - 1;
+
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        gc_pinned_entry_t *e = &pinned_table[mid];
+
+        if (addr < (uintptr_t)e->obj)
+            hi = mid - 1;
+        else if (addr >= (uintptr_t)e->obj + e->size)
+            lo = mid + 1;
+        else
+            return mid;
+    }
+    return -1;
+}
+
+static void *pinned_alloc(size_t size, struct __go_type_descriptor *type,
+                          bool noscan, bool large)
+{
+    extern volatile int gc_inhibit_count;
+
+    if (!gc_heap.initialized)
+        gc_init();
+
+    size_t aligned_size = (size + GC_ALIGN_MASK) & ~(size_t)GC_ALIGN_MASK;
+    if (aligned_size == 0)
+        aligned_size = GC_ALIGN;
+    if (GC_HEADER_SIZE + aligned_size > GC_HEADER_SIZE_MASK)
+        runtime_throw("gc_alloc_pinned: object too large");
+
+    /* Place the header so that the user pointer is GC_PINNED_ALIGN aligned */
+    uint8_t *raw = memalign(GC_PINNED_ALIGN, GC_PINNED_ALIGN + aligned_size);
+    if (!raw && gc_inhibit_count == 0 && !gc_heap.gc_in_progress)
+    {
+        /* Unreachable pinned and large objects may be holding the RAM */
+        gc_collect();
+        raw = memalign(GC_PINNED_ALIGN, GC_PINNED_ALIGN + aligned_size);
+    }
+    if (!raw)
+        runtime_throw("gc_alloc_pinned: out of memory");
+
+    uint8_t *obj = raw + GC_PINNED_ALIGN;
+    gc_header_t *header = gc_get_header(obj);
+
+    uint8_t type_tag = type ? (type->__code & GC_KIND_MASK) : 0;
+    GC_HEADER_SET(header, type_tag, GC_HEADER_SIZE + aligned_size);
+    header->type = type;
+    if (noscan)
+        GC_HEADER_SET_NOSCAN(header);
+    memset(obj, 0, aligned_size);
+
+    /* A vblank collection step may mark (and push) pinned objects */
+    int old_irq = irq_disable();
+
+    if (pinned_count == pinned_capacity)
+    {
+        int grey_capacity = pinned_capacity;
+        pinned_table = grow_array(pinned_table, &pinned_capacity, sizeof(gc_pinned_entry_t));
+        pinned_grey = grow_array(pinned_grey, &grey_capacity, sizeof(void *));
+    }
+
+    /* Insert sorted by address */
+    int i = pinned_count;
+    while (i > 0 && pinned_table[i - 1].obj > obj)
+    {
+        pinned_table[i] = pinned_table[i - 1];
+        i--;
+    }
+    pinned_table[i].obj = obj;
+    pinned_table[i].size = aligned_size;
+    pinned_table[i].raw = raw;
+    pinned_table[i].marked = false;
+    pinned_table[i].large = large;
+    pinned_count++;
+    pinned_update_bounds();
+
+    /* Allocated during an incremental cycle: keep it, scan it at the end */
+    if (pinned_marking)
+    {
+        pinned_table[i].marked = true;
+        if (!GC_HEADER_IS_NOSCAN(header))
+            pinned_push_grey(obj);
+    }
+    irq_restore(old_irq);
+
+    /* Its initializing stores may bypass the write barrier, so the next
+     * minor GC scans the whole object, as for gc_alloc_old() */
+    if (!noscan)
+        gc_remember((uintptr_t)obj | GC_REMSET_OBJECT);
+
+    gc_pinned_bytes += aligned_size;
+    if (large)
+    {
+        gc_heap.large_alloc_count++;
+        gc_heap.large_alloc_total += aligned_size;
+        large_since_gc += aligned_size;
+    }
+
+    return obj;
+}
+
+/* Untyped pinned memory holds no pointers (DMA buffers) */
+void *gc_alloc_pinned(size_t size, struct __go_type_descriptor *type)
+{
+    return pinned_alloc(size, type, type == NULL || type->__ptrdata == 0, false);
+}
+
+/*
+ * Large object space. Unlike gc_alloc_pinned, a NULL type is scanned
+ * conservatively unless the caller said noscan (gc_alloc_noscan), as it
+ * is for semispace objects. Collects first once
+ * GC_LARGE_TRIGGER bytes of large objects have been allocated, since
+ * they never fill the semispace that normally triggers collection.
+ */
+void *gc_alloc_large(size_t size, struct __go_type_descriptor *type, bool noscan)
+{
+    extern volatile int gc_inhibit_count;
+    extern int32_t gc_percent;
+
+    if (large_since_gc + size > GC_LARGE_TRIGGER && gc_percent >= 0 &&
+        gc_inhibit_count == 0 && !gc_heap.gc_in_progress)
+        gc_collect();
+
+    return pinned_alloc(size, type, noscan, true);
+}
+
+/* Free a pinned or large object now. Returns false if obj is not one. */
+bool gc_pinned_free(void *obj)
+{
+    int i = pinned_find((uintptr_t)obj);
+    if (i < 0 || pinned_table[i].obj != obj)
+        return false;
+
+    gc_pinned_entry_t e = pinned_table[i];
+    gc_pinned_bytes -= e.size;
+    if (e.large)
+    {
+        gc_heap.large_alloc_count--;
+        gc_heap.large_alloc_total -= e.size;
+    }
+
+    /* Unlink it before freeing, so a vblank collection step never finds
+     * freed memory in the table or the grey stack */
+    int old_irq = irq_disable();
+
+    /* Freed mid-cycle: it must not be scanned later */
+    for (int g = 0; g < pinned_grey_count; g++)
+    {
+        if (pinned_grey[g] == obj)
+            pinned_grey[g--] = pinned_grey[--pinned_grey_count];
+    }
+
+    for (; i < pinned_count - 1; i++)
+        pinned_table[i] = pinned_table[i + 1];
+    pinned_count--;
+    pinned_update_bounds();
+    irq_restore(old_irq);
+
+    free(e.raw);
+    return true;
+}
+
+void gc_pinned_begin_mark(void)
+{
+    pinned_marking = true;
+    pinned_grey_count = 0;
+}
+
+void gc_pinned_mark(uintptr_t addr)
+{
+    if (!pinned_marking)
+        return;
+
+    int i = pinned_find(addr);
+    if (i < 0 || pinned_table[i].marked)
+        return;
+
+    pinned_table[i].marked = true;
+    if (!GC_HEADER_IS_NOSCAN(gc_get_header(pinned_table[i].obj)))
+        pinned_push_grey(pinned_table[i].obj);
+}
+
+void *gc_pinned_pop_grey(void)
+{
+    if (pinned_grey_count == 0)
+        return NULL;
+    return pinned_grey[--pinned_grey_count];
+}
+
+/* Pinned object by table index (NULL past the end) */
+void *gc_pinned_object(int index)
+{
+    if (index >= pinned_count)
+        return NULL;
+    return pinned_table[index].obj;
+}
+
+/* For remembered set entries, which may outlive their object */
+bool gc_pinned_contains(uintptr_t addr)
+{
+    return gc_maybe_pinned(addr) && pinned_find(addr) >= 0;
+}
+
+void gc_pinned_sweep(void)
+{
+    int kept = 0;
+
+    for (int i = 0; i < pinned_count; i++)
+    {
+        gc_pinned_entry_t *e = &pinned_table[i];
+        if (e->marked)
+        {
+            e->marked = false;
+            pinned_table[kept++] = *e;
+        }
+        else
+        {
+            gc_pinned_bytes -= e->size;
+            if (e->large)
+            {
+                gc_heap.large_alloc_count--;
+                gc_heap.large_alloc_total -= e->size;
+            }
+            free(e->raw);
+        }
+    }
+
+    pinned_count = kept;
+    pinned_marking = false;
+    large_since_gc = 0;
+    pinned_grey_count = 0;
+    pinned_update_bounds();
+}
+
+/* runtime.AllocPinned - zeroed byte buffer that the GC never moves.
+ *
+ * The data pointer is 32-byte aligned and stays valid while the slice (or
+ * any pointer into it) is reachable, so it can be given to DMA.
+ */
+GoSlice runtime_AllocPinned(intptr_t size) __asm__("_runtime.AllocPinned");
+GoSlice runtime_AllocPinned(intptr_t size)
+{
+    if (size < 0)
+        runtime_panicstring("AllocPinned: negative size");
+
+    GoSlice s;
+    s.__values = gc_alloc_pinned((size_t)size, NULL);
+    s.__count = size;
+    s.__capacity = size;
+    return s;
+}
@@ -0,0 +1,101 @@
+/* libgodc/runtime/gc_pool.c - Object pools known to the collector
+ *
+ * A hand-rolled pool (a global []*T free list) keeps every pooled object
+ * alive forever, and the collector copies all of them on every collection.
+ * A runtime pool is a pair of free lists the collector scans as roots:
+ *
+ *   items    what PoolPut returned since the last full collection
+ *   victims  what was still unused at the last full collection
+ *
+ * Each full collection (or incremental cycle start) drops the victims and
+ * makes the items the new victims, like sync.Pool. A pool that is in use
+ * every frame hardly ever reaches gc_alloc(); one that went idle is empty
+ * after two collections and its objects are garbage.
+ *
+ *   pool := runtime.NewPool((*Bullet)(nil))
+ *   b := (*Bullet)(runtime.PoolGet(pool)) // Zeroed only if newly allocated
+ *   runtime.PoolPut(pool, unsafe.Pointer(b))
+ */
+
+#include "gc_semispace.h"
+#include "type_descriptors.h"
+#include "runtime.h"
+#include <stdlib.h>
+
+typedef struct gc_pool
+{
+    struct __go_type_descriptor *type; /* Pooled object type */
+    struct gc_pool *next;
+    void **items;
+    void **victims;
+    uint32_t count;
+    uint32_t victim_count;
+    void *lists[2][GC_POOL_ENTRIES];
+} gc_pool_t;
+
+static gc_pool_t *pools;
+
+void gc_pool_rotate(void)
+{
+    for (gc_pool_t *pool = pools; pool != NULL; pool = pool->next)
+    {
+        void **dropped = pool->victims;
+        pool->victims = pool->items;
+        pool->victim_count = pool->count;
+        pool->items = dropped;
+        pool->count = 0;
+    }
+}
+
+void gc_pool_scan(void (*update)(void **field))
+{
+    for (gc_pool_t *pool = pools; pool != NULL; pool = pool->next)
+    {
+        for (uint32_t i = 0; i < pool->count; i++)
+            update(&pool->items[i]);
+        for (uint32_t i = 0; i < pool->victim_count; i++)
+            update(&pool->victims[i]);
+    }
+}
+
+/* runtime.NewPool - pool of the objects that proto, a nil pointer of the
+ * pooled type, points to. Pools are never freed. */
+gc_pool_t *runtime_NewPool(Eface proto) __asm__("_runtime.NewPool");
+gc_pool_t *runtime_NewPool(Eface proto)
+{
+    if (proto.type == NULL || (proto.type->__code & GC_KIND_MASK) != GO_PTR)
+        runtime_panicstring("NewPool: prototype must be a pointer");
+
+    gc_pool_t *pool = malloc(sizeof(gc_pool_t));
+    if (pool == NULL)
+        runtime_panicstring("NewPool: out of memory");
+
+    pool->type = ((struct __go_ptr_type *)proto.type)->__element_type;
+    pool->items = pool->lists[0];
+    pool->victims = pool->lists[1];
+    pool->count = 0;
+    pool->victim_count = 0;
+    pool->next = pools;
+    pools = pool;
+    return pool;
+}
+
+/* runtime.PoolGet - a pooled object, or a new zeroed one */
+void *runtime_PoolGet(gc_pool_t *pool) __asm__("_runtime.PoolGet");
+void *runtime_PoolGet(gc_pool_t *pool)
+{
+    if (pool->count > 0)
+        return pool->items[--pool->count];
+    if (pool->victim_count > 0)
+        return pool->victims[--pool->victim_count];
+    return gc_alloc(pool->type->__size, pool->type);
+}
+
+/* runtime.PoolPut - keep obj for a later PoolGet. The caller must not use
+ * it afterwards. Dropped (left to the collector) if the pool is full. */
+void runtime_PoolPut(gc_pool_t *pool, void *obj) __asm__("_runtime.PoolPut");
+void runtime_PoolPut(gc_pool_t *pool, void *obj)
+{
+    if (obj != NULL && pool->count < GC_POOL_ENTRIES)
+        pool->items[pool->count++] = obj;
+}
@@ -0,0 +1,497 @@
+/* libgodc/runtime/gc_pretenure.c - Pretenuring into the mature region
+ *
+ * Level data, lookup tables and maps built at startup live for the whole
+ * game, yet the copying collector moves every one of them on every full
+ * collection. Pretenuring learns which allocations those are and puts them
+ * where nothing is copied.
+ *
+ * gccgo does not pass a call site to the allocator, so the site is the
+ * type descriptor. Each full collection charges every object it copies
+ * out of the old semispace (which has therefore survived a collection
+ * already) to its type. A type with at least GC_PRETENURE_MIN_KB of such
+ * survivors in GC_PRETENURE_GCS full collections in a row is pretenured:
+ * gc_alloc() places new objects of that type in the mature region, and the
+ * next full collection moves the existing ones there instead of into
+ * to-space.
+ *
+ * The mature region is one block of GC_MATURE_SIZE_KB, allocated the first
+ * time a type is pretenured. Objects in it keep their normal header and
+ * never move. A full collection marks the ones it reaches, like pinned
+ * objects, and the sweep turns the rest into a first-fit free list. Minor
+ * collections treat the region as old space: the write barrier remembers
+ * mature slots that receive nursery pointers.
+ *
+ * If most of a type's mature bytes die before the next full collection it
+ * was a poor guess; it is demoted and never pretenured again. A full
+ * region simply sends allocations back to the nursery and semispace.
+ */
+
+#include "gc_semispace.h"
+#include "type_descriptors.h"
+#include "runtime.h"
+#include <string.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <arch/irq.h>
+
+_Static_assert((GC_PRETENURE_SITES & (GC_PRETENURE_SITES - 1)) == 0,
+               "GC_PRETENURE_SITES must be a power of two");
+_Static_assert((size_t)GC_MATURE_SIZE_KB * 1024 <= GC_HEADER_SIZE_MASK,
+               "GC_MATURE_SIZE_KB too large for a free block header");
+
+/* Free blocks: NOSCAN headers with this tag, linked through the type
+ * field. They have no object-start bit, so pointers into them find
+ * nothing. */
+#define GC_TAG_MATURE_FREE 0x3E
+
+typedef struct
+{
+    struct __go_type_descriptor *type;
+    uint32_t survived; /* Tenured bytes copied this full GC */
+    uint32_t live;     /* Mature bytes marked this full GC */
+    uint32_t dead;     /* Mature bytes swept this full GC */
+    uint8_t streak;    /* Full GCs in a row with enough survivors */
+    bool pretenured;
+    bool demoted;      /* Its mature objects died: leave it alone */
+} pretenure_site_t;
+
+static pretenure_site_t sites[GC_PRETENURE_SITES];
+static pretenure_site_t sites_prev[GC_PRETENURE_SITES];
+
+uint32_t gc_pretenure_filter[8];
+
+uint8_t *gc_mature_base;
+size_t gc_mature_size;
+size_t gc_mature_bytes;
+
+static uint8_t *mature_bump; /* Nothing allocated at or above */
+static uint32_t *mature_start_map;
+static uint16_t *mature_start_back;
+static uint32_t *mature_mark_map;
+static gc_header_t *mature_free; /* Address ordered */
+
+/* Marked objects whose fields still need scanning, and copies made by a
+ * collection (minor ones too) that have not been scanned yet. Allocated
+ * with the region and grown outside interrupts only; a push that finds it
+ * full in the vblank IRQ sets mature_grey_overflow instead. */
+#define MATURE_GREY_INITIAL 256
+static void **mature_grey;
+static int mature_grey_count;
+static int mature_grey_capacity;
+static bool mature_grey_overflow;
+
+static bool mature_marking;
+
+static inline uint32_t site_hash(const struct __go_type_descriptor *type)
+{
+    return ((uintptr_t)type >> 3) & (GC_PRETENURE_SITES - 1);
+}
+
+/* Entry for type, or NULL; with insert, a new entry while there is room */
+static pretenure_site_t *site_lookup(struct __go_type_descriptor *type, bool insert)
+{
+    uint32_t i = site_hash(type);
+
+    for (int n = 0; n < GC_PRETENURE_SITES; n++)
+    {
+        pretenure_site_t *e = &sites[i];
+        if (e->type == type)
+            return e;
+        if (e->type == NULL)
+        {
+            if (!insert)
+                return NULL;
+            e->type = type;
+            return e;
+        }
+        i = (i + 1) & (GC_PRETENURE_SITES - 1);
+    }
+    return NULL;
+}
+
+static inline size_t mature_granule(const void *p)
+{
+    return (size_t)((const uint8_t *)p - gc_mature_base) / GC_ALIGN;
+}
+
+static inline bool mature_is_marked(const gc_header_t *header)
+{
+    size_t g = mature_granule(header);
+    return (mature_mark_map[g >> 5] >> (g & 31)) & 1;
+}
+
+static inline void mature_set_mark(const gc_header_t *header)
+{
+    size_t g = mature_granule(header);
+    mature_mark_map[g >> 5] |= 1u << (g & 31);
+}
+
+static void mature_push_grey(void *obj)
+{
+    if (mature_grey_count == mature_grey_capacity)
+    {
+        /* KOS malloc is not interrupt safe. The object is already marked
+         * (IRQ steps only run during a cycle), so gc_mature_pop_grey()
+         * finds it again by walking the region. */
+        if (irq_inside_int())
+        {
+            mature_grey_overflow = true;
+            return;
+        }
+
+        int new_capacity = mature_grey_capacity ? mature_grey_capacity * 2 : 32;
+        void *p = realloc(mature_grey, (size_t)new_capacity * sizeof(void *));
+        if (!p)
+            runtime_throw("gc mature region: out of memory");
+        mature_grey = p;
+        mature_grey_capacity = new_capacity;
+    }
+    mature_grey[mature_grey_count++] = obj;
+}
+
+static bool mature_create(void)
+{
+    size_t size = (size_t)GC_MATURE_SIZE_KB * 1024;
+
+    uint8_t *base = memalign(32, size);
+    uint32_t *start_map = memalign(32, GC_START_MAP_BYTES(size));
+    uint16_t *start_back = memalign(32, GC_START_BACK_BYTES(size));
+    uint32_t *mark_map = memalign(32, GC_START_MAP_BYTES(size));
+    void **grey = malloc(MATURE_GREY_INITIAL * sizeof(void *));
+    if (!base || !start_map || !start_back || !mark_map || !grey)
+    {
+        free(base);
+        free(start_map);
+        free(start_back);
+        free(mark_map);
+        free(grey);
+        return false;
+    }
+
+    memset(start_map, 0, GC_START_MAP_BYTES(size));
+    memset(start_back, 0, GC_START_BACK_BYTES(size));
+    memset(mark_map, 0, GC_START_MAP_BYTES(size));
+    mature_start_map = start_map;
+    mature_start_back = start_back;
+    mature_mark_map = mark_map;
+    mature_grey = grey;
+    mature_grey_capacity = MATURE_GREY_INITIAL;
+    mature_bump = base;
+    mature_free = NULL;
+    gc_mature_base = base;
+    gc_mature_size = size;
+    return true;
+}
+
+/* A block of exactly size bytes (header included), or NULL */
+static gc_header_t *mature_take(size_t size)
+{
+    gc_header_t **link = &mature_free;
+
+    for (gc_header_t *b = mature_free; b != NULL;
+         link = (gc_header_t **)&b->type, b = (gc_header_t *)b->type)
+    {
+        size_t bsize = GC_HEADER_GET_SIZE(b);
+        if (bsize < size)
+            continue;
+
+        gc_header_t *next = (gc_header_t *)b->type;
+        if (bsize > size)
+        {
+            /* Any remainder holds at least a header */
+            gc_header_t *rest = (gc_header_t *)((uint8_t *)b + size);
+            GC_HEADER_SET(rest, GC_TAG_MATURE_FREE, bsize - size);
+            GC_HEADER_SET_NOSCAN(rest);
+            rest->type = (struct __go_type_descriptor *)next;
+            next = rest;
+        }
+        *link = next;
+        return b;
+    }
+
+    if ((size_t)(gc_mature_base + gc_mature_size - mature_bump) < size)
+        return NULL;
+
+    gc_header_t *b = (gc_header_t *)mature_bump;
+    mature_bump += size;
+    return b;
+}
+
+void *gc_pretenure_alloc(size_t size, struct __go_type_descriptor *type,
+                         bool noscan, bool needzero)
+{
+    if (type == NULL)
+        return NULL;
+
+    pretenure_site_t *e = site_lookup(type, false);
+    if (!e || !e->pretenured || !gc_mature_base)
+        return NULL; /* A filter collision */
+
+    size_t aligned_size = (size + GC_ALIGN_MASK) & ~(size_t)GC_ALIGN_MASK;
+    if (aligned_size == 0)
+        aligned_size = GC_ALIGN;
+
+    gc_header_t *header = mature_take(GC_HEADER_SIZE + aligned_size);
+    if (!header)
+        return NULL;
+
+    GC_HEADER_SET(header, type->__code & GC_KIND_MASK, GC_HEADER_SIZE + aligned_size);
+    header->type = type;
+    if (noscan)
+        GC_HEADER_SET_NOSCAN(header);
+    gc_start_map_set(mature_start_map, mature_start_back, gc_mature_base, header,
+                     GC_HEADER_SIZE + aligned_size);
+    gc_mature_bytes += GC_HEADER_SIZE + aligned_size;
+
+    void *obj = gc_get_user_ptr(header);
+    if (needzero)
+        memset(obj, 0, aligned_size);
+
+    if (!noscan)
+    {
+        /* Its initializing stores may bypass the write barrier, so the
+         * next minor GC scans the whole object, as for gc_alloc_old() */
+        gc_remember((uintptr_t)obj | GC_REMSET_OBJECT);
+
+        /* Allocated during an incremental cycle: scan it at the finish */
+        if (mature_marking)
+            mature_push_grey(obj);
+    }
+    if (mature_marking)
+        mature_set_mark(header);
+
+    return obj;
+}
+
+/* Move a survivor of a pretenured type into the region, during a
+ * collection. The copy is grey until gc_mature_pop_grey() returns it. */
+void *gc_pretenure_copy(gc_header_t *header)
+{
+    pretenure_site_t *e = header->type ? site_lookup(header->type, false) : NULL;
+    if (!e || !e->pretenured || !gc_mature_base)
+        return NULL;
+
+    size_t size = GC_HEADER_GET_SIZE(header);
+    gc_header_t *copy = mature_take(size);
+    if (!copy)
+        return NULL;
+
+    memcpy(copy, header, size);
+    gc_start_map_set(mature_start_map, mature_start_back, gc_mature_base, copy, size);
+    gc_mature_bytes += size;
+    if (mature_marking)
+        mature_set_mark(copy);
+
+    void *obj = gc_get_user_ptr(copy);
+    if (!GC_HEADER_IS_NOSCAN(copy))
+        mature_push_grey(obj);
+    return obj;
+}
+
+void gc_pretenure_survivor(struct __go_type_descriptor *type, size_t size)
+{
+    if (GC_MATURE_SIZE_KB == 0 || type == NULL)
+        return;
+
+    pretenure_site_t *e = site_lookup(type, true);
+    if (e)
+        e->survived += size;
+}
+
+void gc_mature_begin_mark(void)
+{
+    mature_marking = true;
+}
+
+void gc_mature_mark(uintptr_t addr)
+{
+    if (!mature_marking)
+        return;
+
+    gc_header_t *header = gc_start_map_find(mature_start_map, mature_start_back,
+                                            (uintptr_t)gc_mature_base, addr);
+    if (header == NULL || mature_is_marked(header))
+        return;
+
+    mature_set_mark(header);
+    if (!GC_HEADER_IS_NOSCAN(header))
+        mature_push_grey(gc_get_user_ptr(header));
+}
+
+/* Grey every marked object again, after pushes were dropped in an IRQ.
+ * Rescanning the ones already scanned is harmless. */
+static void mature_regrey(void)
+{
+    uint8_t *p = gc_mature_base;
+
+    while (p < mature_bump)
+    {
+        gc_header_t *header = (gc_header_t *)p;
+        if (GC_HEADER_GET_TAG(header) != GC_TAG_MATURE_FREE &&
+            !GC_HEADER_IS_NOSCAN(header) && mature_is_marked(header))
+            mature_push_grey(gc_get_user_ptr(header));
+        p += GC_HEADER_GET_SIZE(header);
+    }
+}
+
+void *gc_mature_pop_grey(void)
+{
+    if (mature_grey_count == 0 && mature_grey_overflow && !irq_inside_int())
+    {
+        mature_grey_overflow = false;
+        mature_regrey();
+    }
+
+    if (mature_grey_count == 0)
+        return NULL;
+    return mature_grey[--mature_grey_count];
+}
+
+void gc_mature_walk(void (*fn)(void *obj))
+{
+    uint8_t *p = gc_mature_base;
+
+    while (p < mature_bump)
+    {
+        gc_header_t *header = (gc_header_t *)p;
+        if (GC_HEADER_GET_TAG(header) != GC_TAG_MATURE_FREE)
+            fn(gc_get_user_ptr(header));
+        p += GC_HEADER_GET_SIZE(header);
+    }
+}
+
+/* Free [lo, hi) as one block, appended to the address-ordered list */
+static void mature_free_run(gc_header_t ***tail, uint8_t *lo, uint8_t *hi)
+{
+    gc_header_t *b = (gc_header_t *)lo;
+    GC_HEADER_SET(b, GC_TAG_MATURE_FREE, hi - lo);
+    GC_HEADER_SET_NOSCAN(b);
+    b->type = NULL;
+    **tail = b;
+    *tail = (gc_header_t **)&b->type;
+}
+
+/* Charge each object to its type, free the unmarked ones (merging
+ * neighbouring free blocks) and give a free tail back to the bump pointer */
+void gc_mature_sweep(void)
+{
+    mature_marking = false;
+    mature_grey_count = 0;
+    mature_grey_overflow = false;
+    if (!gc_mature_base)
+        return;
+
+    gc_header_t **tail = &mature_free;
+    uint8_t *run = NULL; /* Start of the free run ending at p */
+    uint8_t *p = gc_mature_base;
+
+    mature_free = NULL;
+    while (p < mature_bump)
+    {
+        gc_header_t *header = (gc_header_t *)p;
+        size_t size = GC_HEADER_GET_SIZE(header);
+
+        if (GC_HEADER_GET_TAG(header) == GC_TAG_MATURE_FREE)
+        {
+            if (!run)
+                run = p;
+        }
+        else
+        {
+            pretenure_site_t *e = site_lookup(header->type, false);
+            if (mature_is_marked(header))
+            {
+                if (e)
+                    e->live += size;
+                if (run)
+                {
+                    mature_free_run(&tail, run, p);
+                    run = NULL;
+                }
+            }
+            else
+            {
+                if (e)
+                    e->dead += size;
+                gc_start_map_clear(mature_start_map, gc_mature_base, p, p + GC_ALIGN);
+                gc_mature_bytes -= size;
+                if (!run)
+                    run = p;
+            }
+        }
+        p += size;
+    }
+
+    if (run)
+        mature_bump = run;
+    *tail = NULL;
+    gc_start_map_clear(mature_mark_map, gc_mature_base, gc_mature_base, p);
+}
+
+/* After a full collection: promote types whose survivors keep coming
+ * back, demote pretenured ones whose mature objects died, forget types
+ * with no recent survivors and rebuild the allocation filter. */
+void gc_pretenure_collected(void)
+{
+    if (GC_MATURE_SIZE_KB == 0)
+        return;
+
+    bool any = false;
+
+    memcpy(sites_prev, sites, sizeof(sites));
+    memset(sites, 0, sizeof(sites));
+    memset(gc_pretenure_filter, 0, sizeof(gc_pretenure_filter));
+
+    for (int i = 0; i < GC_PRETENURE_SITES; i++)
+    {
+        pretenure_site_t e = sites_prev[i];
+        if (e.type == NULL)
+            continue;
+
+        if (e.pretenured)
+        {
+            if (e.dead > e.live)
+            {
+                e.pretenured = false;
+                e.demoted = true;
+            }
+        }
+        else if (!e.demoted)
+        {
+            if (e.survived >= (uint32_t)GC_PRETENURE_MIN_KB * 1024)
+                e.pretenured = ++e.streak >= GC_PRETENURE_GCS;
+            else
+                e.streak = 0;
+            if (!e.pretenured && e.streak == 0)
+                continue;
+        }
+
+        e.survived = e.live = e.dead = 0;
+        *site_lookup(e.type, true) = e;
+        any |= e.pretenured;
+    }
+
+    if (any && !gc_mature_base && !mature_create())
+    {
+        /* No memory for the region: keep tracking, allocate normally */
+        for (int i = 0; i < GC_PRETENURE_SITES; i++)
+            sites[i].pretenured = false;
+        return;
+    }
+
+    for (int i = 0; i < GC_PRETENURE_SITES; i++)
+    {
+        if (sites[i].pretenured)
+        {
+            uint32_t bit = ((uintptr_t)sites[i].type >> 3) & 255;
+            gc_pretenure_filter[bit >> 5] |= 1u << (bit & 31);
+        }
+    }
+}
+
+/* runtime.gcMatureBytes - bytes of live objects in the mature region */
+uintptr_t runtime_gcMatureBytes(void) __asm__("_runtime.gcMatureBytes");
+uintptr_t runtime_gcMatureBytes(void)
+{
+    return gc_mature_bytes;
+}
@@ -0,0 +1,195 @@
+/* libgodc/runtime/gc_profile.c - Sampling allocation profiler
+ *
+ * Records roughly one allocation per `rate` bytes, keyed by type
+ * descriptor and call stack. The stack is a frame-pointer walk (the
+ * runtime and tests build with -fno-omit-frame-pointer), so it costs a
+ * few loads per frame and needs no unwind tables.
+ *
+ * gc_profile_write() dumps the table in the format below; tools/allocprof
+ * symbolizes it against the game's ELF. All fields are 32-bit little
+ * endian:
+ *
+ *   header:  magic "GODCAPRF", version, rate, depth, records, dropped
+ *   record:  type, samples, bytes, frames, pc[depth]
+ *
+ * `bytes` is the sum of the sampled request sizes. `dropped` counts
+ * samples that found the table full.
+ */
+
+#include "gc_semispace.h"
+#include "runtime.h"
+#include "dc_platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arch/arch.h>
+
+#define GC_PROFILE_MAGIC "GODCAPRF"
+#define GC_PROFILE_VERSION 1
+
+typedef struct
+{
+    struct __go_type_descriptor *type; /* NULL for untyped allocations */
+    uint32_t samples;
+    uint32_t bytes;
+    uint32_t frames;
+    uint32_t pc[GC_PROFILE_DEPTH];
+} gc_profile_record_t;
+
+size_t gc_profile_countdown = SIZE_MAX;
+
+static size_t profile_rate;
+static gc_profile_record_t *profile_table; /* GC_PROFILE_BUCKETS, open addressing */
+static uint32_t profile_records;
+static uint32_t profile_dropped;
+static uint32_t profile_seed = 0x2545F491;
+
+/* Randomize the interval (mean = rate) so that allocation patterns with
+ * the same period as the rate are not always, or never, sampled. */
+static size_t next_interval(void)
+{
+    profile_seed ^= profile_seed << 13;
+    profile_seed ^= profile_seed >> 17;
+    profile_seed ^= profile_seed << 5;
+    return profile_rate / 2 + profile_seed % profile_rate + 1;
+}
+
+/* Inlined so that fp is gc_profile_sample's frame, whose return
+ * address is in gc_alloc */
+static inline __attribute__((always_inline)) uint32_t walk_stack(uint32_t *pc)
+{
+    uintptr_t fp = arch_get_fptr();
+    uint32_t n = 0;
+
+    while (n < GC_PROFILE_DEPTH)
+    {
+        if ((fp & 3) || fp < DC_RAM_START || fp >= DC_RAM_END - 8)
+            break;
+
+        pc[n++] = arch_fptr_ret_addr(fp);
+
+        /* Stacks grow down: callers' frames are always higher */
+        uintptr_t next = arch_fptr_next(fp);
+        if (next <= fp)
+            break;
+        fp = next;
+    }
+    return n;
+}
+
+void gc_profile_sample(size_t size, struct __go_type_descriptor *type)
+{
+    gc_profile_countdown = next_interval();
+    if (!profile_table)
+        return;
+
+    uint32_t pc[GC_PROFILE_DEPTH];
+    uint32_t frames = walk_stack(pc);
+
+    uint32_t hash = (uint32_t)(uintptr_t)type * 0x9E3779B1u;
+    for (uint32_t i = 0; i < frames; i++)
+        hash = (hash ^ pc[i]) * 0x01000193u;
+
+    for (uint32_t probe = 0; probe < GC_PROFILE_BUCKETS; probe++)
+    {
+        gc_profile_record_t *r = &profile_table[(hash + probe) % GC_PROFILE_BUCKETS];
+
+        if (r->samples == 0)
+        {
+            r->type = type;
+            r->frames = frames;
+            memcpy(r->pc, pc, frames * sizeof(uint32_t));
+            profile_records++;
+        }
+        else if (r->type != type || r->frames != frames ||
+                 memcmp(r->pc, pc, frames * sizeof(uint32_t)) != 0)
+        {
+            continue;
+        }
+
+        r->samples++;
+        r->bytes += size;
+        return;
+    }
+
+    profile_dropped++;
+}
+
+/* Changing the rate discards what was collected so far */
+void gc_profile_set_rate(size_t rate)
+{
+    if (rate && !profile_table)
+    {
+        profile_table = malloc(GC_PROFILE_BUCKETS * sizeof(gc_profile_record_t));
+        if (!profile_table)
+            runtime_throw("gc_profile_set_rate: out of memory");
+    }
+    if (profile_table)
+        memset(profile_table, 0, GC_PROFILE_BUCKETS * sizeof(gc_profile_record_t));
+
+    profile_records = 0;
+    profile_dropped = 0;
+    profile_rate = rate;
+    gc_profile_countdown = rate ? next_interval() : SIZE_MAX;
+}
+
+bool gc_profile_write(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+
+    uint32_t header[5] = {GC_PROFILE_VERSION, (uint32_t)profile_rate,
+                          GC_PROFILE_DEPTH, profile_records, profile_dropped};
+    bool ok = fwrite(GC_PROFILE_MAGIC, 8, 1, f) == 1 &&
+              fwrite(header, sizeof(header), 1, f) == 1;
+
+    for (uint32_t i = 0; ok && profile_table && i < GC_PROFILE_BUCKETS; i++)
+    {
+        gc_profile_record_t *r = &profile_table[i];
+        if (r->samples == 0)
+            continue;
+
+        uint32_t rec[4 + GC_PROFILE_DEPTH] = {(uint32_t)(uintptr_t)r->type,
+                                              r->samples, r->bytes, r->frames};
+        memcpy(&rec[4], r->pc, sizeof(r->pc));
+        ok = fwrite(rec, sizeof(rec), 1, f) == 1;
+    }
+
+    return fclose(f) == 0 && ok;
+}
+
+/* runtime.SetAllocProfileRate - sample about one allocation per rate
+ * bytes; 0 turns the profiler off. Returns the previous rate. */
+intptr_t runtime_SetAllocProfileRate(intptr_t rate) __asm__("_runtime.SetAllocProfileRate");
+intptr_t runtime_SetAllocProfileRate(intptr_t rate)
+{
+    intptr_t old = (intptr_t)profile_rate;
+    if (rate < 0)
+        runtime_panicstring("SetAllocProfileRate: negative rate");
+    gc_profile_set_rate((size_t)rate);
+    return old;
+}
+
+/* runtime.WriteAllocProfile - dump the samples to a file, e.g.
+ * "/pc/alloc.prof" to write to the host over dcload. */
+bool runtime_WriteAllocProfile(GoString path) __asm__("_runtime.WriteAllocProfile");
+bool runtime_WriteAllocProfile(GoString path)
+{
+    char buf[256];
+    if (path.len <= 0 || path.len >= (intptr_t)sizeof(buf))
+        return false;
+    memcpy(buf, path.str, path.len);
+    buf[path.len] = '\0';
+    return gc_profile_write(buf);
+}
+
+/* Samples recorded since the rate was last set, for tests */
+uint32_t runtime_allocProfileSamples(void) __asm__("_runtime.allocProfileSamples");
+uint32_t runtime_allocProfileSamples(void)
+{
+    uint32_t total = 0;
+    for (uint32_t i = 0; profile_table && i < GC_PROFILE_BUCKETS; i++)
+        total += profile_table[i].samples;
+    return total + profile_dropped;
+}
@@ -0,0 +1,274 @@
+/* libgodc/runtime/gc_resize.c - Heap size and the soft memory limit
+ *
+ * GC_SEMISPACE_SIZE_KB is only the initial size. gc_heap_resize() called
+ * before gc_init() replaces it; called later it resizes between
+ * collections:
+ *
+ *   1. a full collection, to measure the live heap (it must fit in three
+ *      quarters of the new size)
+ *   2. the idle semispace is reallocated at the new size
+ *   3. a second full collection flips into it
+ *   4. the now idle semispace is reallocated too
+ *
+ * Each space keeps its allocated size in gc_heap.space_capacity, which is
+ * never below space_size, so a failed memalign leaves a working heap at
+ * the old size. Mark-compact mode has a single space and can only move its
+ * limit within the capacity it was initialised with.
+ *
+ * The memory limit (debug.SetMemoryLimit) is a soft bound on
+ * gc_heap_in_use(): semispace, nursery, pinned/large and mature bytes.
+ * The pacer lowers its trigger to stay below it. A full collection that
+ * leaves the heap above GC_LOW_MEMORY_PERCENT of the limit, or of the
+ * semispace, is a low-memory event: the C callback runs, and the channel
+ * registered with runtime.NotifyLowMemory gets the bytes in use
+ * (non-blocking; a full buffer drops the event). Texture and audio caches
+ * can drop entries there, before gc_alloc() runs out of room. Running out
+ * is a low-memory event too, followed by another collection and, if
+ * GC_SEMISPACE_MAX_KB allows, a larger heap before "out of memory" is
+ * thrown.
+ */
+
+#include "gc_semispace.h"
+#include "chan.h"
+#include "runtime.h"
+#include <string.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <arch/cache.h>
+
+/* Sizes are rounded to small-object pages (and whole start-map words) */
+#define GC_RESIZE_ALIGN GC_SMALL_PAGE_SIZE
+
+/* A full nursery must fit when it is promoted */
+#define GC_RESIZE_MIN (2 * GC_NURSERY_SIZE)
+
+/* Live bytes a space may hold after a resize: the default trigger */
+#define GC_RESIZE_FITS(live, size) ((live) <= (size) - (size) / 4)
+
+extern bool chansend(hchan *c, void *elem, bool block);
+
+static int64_t memory_limit = GC_MEMORY_LIMIT_KB ? (int64_t)GC_MEMORY_LIMIT_KB * 1024 : INT64_MAX;
+static void (*low_memory_callback)(size_t in_use, size_t limit);
+static hchan *low_memory_chan; /* Root while registered */
+static uint32_t low_memory_events;
+
+static inline size_t semispace_used(void)
+{
+    return (size_t)(gc_heap.alloc_ptr - gc_heap.space[gc_heap.active_space]);
+}
+
+#if !GC_MARK_COMPACT
+/* Replace space i with a fresh block of size bytes. The old block is only
+ * freed once the new one is allocated. */
+static bool gc_space_realloc(int i, size_t size)
+{
+    if (gc_heap.space_capacity[i] == size)
+        return true;
+
+    uint8_t *space = (uint8_t *)memalign(32, size);
+    uint32_t *start_map = (uint32_t *)memalign(32, GC_START_MAP_BYTES(size));
+    uint16_t *start_back = (uint16_t *)memalign(32, GC_START_BACK_BYTES(size));
+    uint32_t *card_map = (uint32_t *)memalign(32, GC_CARD_MAP_BYTES(size));
+    if (!space || !start_map || !start_back || !card_map)
+    {
+        free(space);
+        free(start_map);
+        free(start_back);
+        free(card_map);
+        return false;
+    }
+
+    /* The block may have cached lines from its last owner, and to-space is
+     * filled with store queue copies that bypass the cache */
+    dcache_purge_range((uintptr_t)space, size);
+    memset(start_map, 0, GC_START_MAP_BYTES(size));
+    memset(start_back, 0, GC_START_BACK_BYTES(size));
+
+    if (gc_heap.pending_invalidate_space == gc_heap.space[i])
+    {
+        gc_heap.pending_invalidate_space = NULL;
+        gc_heap.invalidate_offset = 0;
+    }
+    free(gc_heap.space[i]);
+    free(gc_heap.start_map[i]);
+    free(gc_heap.start_back[i]);
+    free(gc_heap.card_map[i]);
+
+    gc_heap.space[i] = space;
+    gc_heap.start_map[i] = start_map;
+    gc_heap.start_back[i] = start_back;
+    gc_heap.card_map[i] = card_map;
+    gc_heap.space_capacity[i] = size;
+    gc_heap.clean_from[i] = space + size; /* Nothing pre-zeroed yet */
+    return true;
+}
+#endif
+
+bool gc_heap_resize(size_t size)
+{
+    extern volatile int gc_inhibit_count;
+
+    size = (size + GC_RESIZE_ALIGN - 1) & ~(size_t)(GC_RESIZE_ALIGN - 1);
+    if (size < GC_RESIZE_MIN)
+        size = GC_RESIZE_MIN;
+
+    if (!gc_heap.initialized)
+    {
+        gc_heap.space_size = size;
+        return true;
+    }
+
+    if (gc_heap.gc_in_progress || gc_inhibit_count > 0)
+        return false;
+    if (size == gc_heap.space_size)
+        return true;
+
+    if (gc_heap.cycle_active)
+        gc_collect_finish();
+    gc_collect();
+    if (!GC_RESIZE_FITS(semispace_used(), size))
+        return false;
+
+#if GC_MARK_COMPACT
+    /* Live objects are at the bottom; only the limit moves */
+    if (size > gc_heap.space_capacity[0])
+        return false;
+    gc_heap.space_size = size;
+    gc_heap.alloc_limit = gc_heap.space[0] + size;
+    return true;
+#else
+    if (!gc_space_realloc(1 - gc_heap.active_space, size))
+        return false;
+
+    /* Shrinking: the new to-space bounds alloc_limit during the copy. Every
+     * live object lies below size in from-space. */
+    if (size < gc_heap.space_size)
+        gc_heap.space_size = size;
+    gc_collect();
+
+    /* Growing needs both spaces to have room; shrinking has already
+     * happened and the larger block stays until the next resize */
+    if (!gc_space_realloc(1 - gc_heap.active_space, size))
+        return gc_heap.space_size == size;
+
+    gc_heap.space_size = size;
+    gc_heap.alloc_limit = gc_heap.space[gc_heap.active_space] + size;
+    return true;
+#endif
+}
+
+/* Semispace bytes in use that keep gc_heap_in_use() under the limit */
+size_t gc_memlimit_goal(void)
+{
+    if (memory_limit == INT64_MAX)
+        return SIZE_MAX;
+
+    size_t other = gc_heap_in_use() - semispace_used();
+    if ((uint64_t)memory_limit <= other)
+        return 0;
+    return (size_t)((uint64_t)memory_limit - other);
+}
+
+static void gc_low_memory(size_t in_use)
+{
+    static bool notifying; /* The callback may allocate and collect */
+
+    if (notifying)
+        return;
+    notifying = true;
+    low_memory_events++;
+
+    size_t limit = memory_limit == INT64_MAX ? gc_heap.space_size : (size_t)memory_limit;
+    if (low_memory_callback)
+        low_memory_callback(in_use, limit);
+    if (low_memory_chan)
+    {
+        intptr_t bytes = (intptr_t)in_use;
+        chansend(low_memory_chan, &bytes, false);
+    }
+    notifying = false;
+}
+
+void gc_memlimit_collected(void)
+{
+    size_t in_use = gc_heap_in_use();
+    size_t space_high = gc_heap.space_size / 100 * GC_LOW_MEMORY_PERCENT;
+
+    if (semispace_used() >= space_high ||
+        (memory_limit != INT64_MAX &&
+         (uint64_t)in_use >= (uint64_t)memory_limit / 100 * GC_LOW_MEMORY_PERCENT))
+        gc_low_memory(in_use);
+}
+
+void gc_heap_exhausted(size_t request)
+{
+    gc_low_memory(gc_heap_in_use());
+    gc_collect();
+
+#if GC_SEMISPACE_MAX_KB
+    const size_t max = (size_t)GC_SEMISPACE_MAX_KB * 1024;
+    size_t need = semispace_used() + request;
+    size_t size = gc_heap.space_size;
+
+    if (gc_heap.alloc_ptr + request <= gc_heap.alloc_limit)
+        return;
+    while (size < max && !GC_RESIZE_FITS(need, size))
+        size = size * 2 < max ? size * 2 : max;
+    if (size > gc_heap.space_size)
+        gc_heap_resize(size);
+#else
+    (void)request;
+#endif
+}
+
+void gc_set_low_memory_callback(void (*fn)(size_t in_use, size_t limit))
+{
+    low_memory_callback = fn;
+}
+
+/* runtime.SetHeapSize - resize the heap (each semispace, or the compacted
+ * heap) to bytes. Returns false if the live heap does not fit or the
+ * memory is not available; the heap keeps its old size. */
+bool runtime_SetHeapSize(intptr_t bytes) __asm__("_runtime.SetHeapSize");
+bool runtime_SetHeapSize(intptr_t bytes)
+{
+    if (bytes <= 0)
+        runtime_panicstring("SetHeapSize: size must be positive");
+    return gc_heap_resize((size_t)bytes);
+}
+
+/* debug.SetMemoryLimit - soft limit on heap bytes in use, math.MaxInt64
+ * for none. A negative limit only reads the current one. */
+int64_t debug_SetMemoryLimit(int64_t limit) __asm__("debug.SetMemoryLimit");
+int64_t debug_SetMemoryLimit(int64_t limit)
+{
+    int64_t old = memory_limit;
+    if (limit >= 0)
+        memory_limit = limit;
+    return old;
+}
+
+/* runtime.NotifyLowMemory - send the bytes in use on ch (a chan int) at
+ * each low-memory event, nil to stop. Use a buffered channel: an event
+ * that finds it full is dropped. */
+void runtime_NotifyLowMemory(hchan *ch) __asm__("_runtime.NotifyLowMemory");
+void runtime_NotifyLowMemory(hchan *ch)
+{
+    static bool rooted;
+
+    if (ch && ch->elemsize != sizeof(intptr_t))
+        runtime_panicstring("NotifyLowMemory: want chan int");
+    if (!rooted)
+    {
+        gc_add_root((void **)&low_memory_chan);
+        rooted = true;
+    }
+    low_memory_chan = ch;
+}
+
+/* Low-memory events so far, for tests */
+uint32_t runtime_gcLowMemoryEvents(void) __asm__("_runtime.gcLowMemoryEvents");
+uint32_t runtime_gcLowMemoryEvents(void)
+{
+    return low_memory_events;
+}
@@ -45,7 +45,9 @@ void *runtime_mallocgc(size_t size, struct __go_type_descriptor *type, bool need
         return NULL;
     }
 
-    (void)needzero;
+    /* needzero=false: the compiler initializes the whole object itself */
+    if (!needzero)
+        return gc_alloc_nozero(size, type);
     return gc_alloc_impl(size, type);
 }
 
@@ -127,7 +129,11 @@ int runtime_typedslicecopy(struct __go_type_descriptor *t,
     size_t elem_size = t ? t->__size : 1;
 
     if (elem_size > 0)
+    {
         memmove(dst, src, (size_t)n * elem_size);
+        if (t && t->__ptrdata != 0)
+            gc_write_barrier_range(dst, (size_t)n * elem_size);
+    }
     return n;
 }
 
@@ -166,9 +172,92 @@ int32_t gc_percent = 100;
 void runtime_GC(void) __asm__("_runtime.GC");
 void runtime_GC(void)
 {
+    /* An incremental cycle keeps floating garbage; finish it, then collect */
+    if (gc_heap.cycle_active)
+        gc_collect_finish();
     gc_full_collect_impl();
 }
 
+/* Incremental collection control.
+ *
+ * SetGCIncremental(true) makes the heap-threshold trigger start a cycle
+ * instead of a full collection; the cycle advances in GCStep, in
+ * scheduler slack (schedule_with_budget) and on vblank. Disabling it
+ * completes any active cycle. Returns the previous setting.
+ */
+bool runtime_SetGCIncremental(bool enabled) __asm__("_runtime.SetGCIncremental");
+bool runtime_SetGCIncremental(bool enabled)
+{
+    bool old = gc_heap.incremental;
+    gc_heap.incremental = enabled;
+    if (!enabled && gc_heap.cycle_active)
+        gc_collect_finish();
+    return old;
+}
+
+/* SetGCDepthFirst chooses the copy order: depth-first places each child
+ * next to its parent (better cache locality when walking trees and lists
+ * after a collection), breadth-first is plain Cheney order. Returns the
+ * previous setting.
+ */
+bool runtime_SetGCDepthFirst(bool enabled) __asm__("_runtime.SetGCDepthFirst");
+bool runtime_SetGCDepthFirst(bool enabled)
+{
+    bool old = gc_heap.depth_first;
+    gc_heap.depth_first = enabled;
+    return old;
+}
+
+/* GCStep advances the incremental cycle for up to budgetUs microseconds,
+ * starting one if none is active. Returns true while work remains.
+ */
+bool runtime_GCStep(uint32_t budget_us) __asm__("_runtime.GCStep");
+bool runtime_GCStep(uint32_t budget_us)
+{
+    if (!gc_heap.cycle_active)
+        gc_collect_start();
+    return gc_collect_step(budget_us);
+}
+
+/* Minor (nursery) GC statistics, for benchmarks */
+uint32_t runtime_gcMinorCount(void) __asm__("_runtime.gcMinorCount");
+uint32_t runtime_gcMinorCount(void)
+{
+    return gc_heap.minor_count;
+}
+
+int64_t runtime_gcLastMinorPause(void) __asm__("_runtime.gcLastMinorPause");
+int64_t runtime_gcLastMinorPause(void)
+{
+    return (int64_t)gc_heap.last_minor_pause_us;
+}
+
+/* Collector mode and heap capacity, for comparing builds */
+bool runtime_gcMarkCompact(void) __asm__("_runtime.gcMarkCompact");
+bool runtime_gcMarkCompact(void)
+{
+    return GC_MARK_COMPACT;
+}
+
+int64_t runtime_gcHeapCapacity(void) __asm__("_runtime.gcHeapCapacity");
+int64_t runtime_gcHeapCapacity(void)
+{
+    return (int64_t)gc_heap.space_size;
+}
+
+/* Finish deferred invalidation and pre-zero all free memory, for tests.
+ * Returns the number of chunks cleared. */
+int32_t runtime_gcPrezeroAll(void) __asm__("_runtime.gcPrezeroAll");
+int32_t runtime_gcPrezeroAll(void)
+{
+    int32_t chunks = 0;
+    while (gc_invalidate_incremental())
+        ;
+    while (gc_prezero_incremental())
+        chunks++;
+    return chunks;
+}
+
 int32_t debug_SetGCPercent(int32_t percent) __asm__("debug.SetGCPercent");
 int32_t debug_SetGCPercent(int32_t percent)
 {
@@ -0,0 +1,214 @@
+/* libgodc/runtime/gc_scan_plan.c - Per-type scan plans
+ *
+ * gc_scan_object() used to decode a type's gcdata bitmap for every element
+ * of every object, and scanned GC-program types conservatively. A scan plan
+ * is built the first time the collector meets a type and cached by type
+ * descriptor:
+ *
+ *   - up to GC_SCAN_PLAN_MAX_OFFSETS pointer words: a list of byte offsets,
+ *     so scanning an element is one tight loop;
+ *   - more than that: a pointer bitmap (the type's own gcdata, or the
+ *     expansion of its GC program) for gc_scan_gcdata_bitmap().
+ *
+ * GC programs (types with GC_KIND_GCPROG, usually big arrays of structs)
+ * are run once here. gcdata then holds a 4-byte length and the program:
+ *
+ *   00000000      stop
+ *   0nnnnnnn      emit n bits copied from the next (n+7)/8 bytes
+ *   10000000 n c  repeat the previous n bits c times; n, c are varints
+ *   1nnnnnnn c    repeat the previous n bits c times; c is a varint
+ *
+ * Plans live in KOS malloc memory and are never freed: there is one per
+ * pointerful type that reaches the heap. KOS malloc is not interrupt safe,
+ * so a collection step in the vblank IRQ only uses plans that already
+ * exist; a type met there for the first time is scanned without one.
+ */
+
+#include "gc_semispace.h"
+#include "runtime.h"
+#include <stdlib.h>
+#include <string.h>
+#include <arch/irq.h>
+
+static gc_scan_plan_t *plan_table[GC_SCAN_PLAN_BUCKETS];
+static uint32_t plan_count;
+
+/* Type descriptors and gcdata live in .rodata/.data (P1 or P2 RAM) */
+static inline bool in_ram(const void *p)
+{
+    uintptr_t a = (uintptr_t)p;
+    return (a >= 0x8c000000 && a < 0x8d000000) || (a >= 0xac000000 && a < 0xad000000);
+}
+
+static size_t read_varint(const uint8_t **p)
+{
+    size_t v = 0;
+    for (unsigned shift = 0; shift < 32; shift += 7)
+    {
+        uint8_t b = *(*p)++;
+        v |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    return v;
+}
+
+static inline bool get_bit(const uint8_t *bits, size_t i)
+{
+    return (bits[i >> 3] >> (i & 7)) & 1;
+}
+
+/* Expand a GC program into bits (zeroed, nbits long). False if malformed. */
+static bool run_gcprog(const uint8_t *prog, uint8_t *bits, size_t nbits)
+{
+    size_t n = 0;
+
+    for (;;)
+    {
+        uint8_t inst = *prog++;
+        if (inst == 0)
+            return true;
+
+        if (!(inst & 0x80))
+        {
+            /* Literal bits */
+            if (n + inst > nbits)
+                return false;
+            for (size_t i = 0; i < inst; i++)
+            {
+                if (get_bit(prog, i))
+                    bits[(n + i) >> 3] |= 1 << ((n + i) & 7);
+            }
+            prog += (inst + 7) / 8;
+            n += inst;
+            continue;
+        }
+
+        /* Repeat: each new bit equals the one len bits before it */
+        size_t len = inst & 0x7F;
+        if (len == 0)
+            len = read_varint(&prog);
+        size_t total = len * read_varint(&prog);
+        if (len == 0 || len > n || total / len > nbits || n + total > nbits)
+            return false;
+        for (size_t i = n; i < n + total; i++)
+        {
+            if (get_bit(bits, i - len))
+                bits[i >> 3] |= 1 << (i & 7);
+        }
+        n += total;
+    }
+}
+
+static gc_scan_plan_t *build_plan(struct __go_type_descriptor *type)
+{
+    size_t nwords = type->__ptrdata / sizeof(void *);
+    const uint8_t *bitmap = type->__gcdata;
+    uint8_t *expanded = NULL;
+
+    if (!in_ram(bitmap))
+        return NULL;
+
+    if (GC_TYPE_USES_GCPROG(type))
+    {
+        /* The program may describe the whole type, not just ptrdata */
+        size_t size_words = type->__size / sizeof(void *);
+        size_t nbits = size_words > nwords ? size_words : nwords;
+        expanded = calloc((nbits + 31) / 32, 4);
+        if (!expanded)
+            return NULL;
+        if (!run_gcprog(bitmap + 4, expanded, nbits))
+        {
+            free(expanded);
+            return NULL;
+        }
+        bitmap = expanded;
+    }
+
+    uint32_t count = 0;
+    for (size_t i = 0; i < nwords; i++)
+        count += get_bit(bitmap, i);
+
+    bool use_offsets = count <= GC_SCAN_PLAN_MAX_OFFSETS;
+    gc_scan_plan_t *plan = malloc(sizeof(gc_scan_plan_t) +
+                                  (use_offsets ? count * sizeof(uint32_t) : 0));
+    if (!plan)
+    {
+        free(expanded);
+        return NULL;
+    }
+
+    plan->type = type;
+    plan->count = count;
+    plan->nwords = nwords;
+    plan->bitmap = NULL;
+
+    if (use_offsets)
+    {
+        uint32_t k = 0;
+        for (size_t i = 0; i < nwords; i++)
+        {
+            if (get_bit(bitmap, i))
+                plan->offsets[k++] = i * sizeof(void *);
+        }
+        free(expanded);
+    }
+    else
+    {
+        /* Keep the expansion; a plain gcdata bitmap is used in place */
+        plan->bitmap = bitmap;
+    }
+    return plan;
+}
+
+/*
+ * Plan for a pointerful type, or NULL if the type descriptor looks invalid
+ * or the plan cannot be built yet (the caller then falls back to
+ * gc_scan_single_element).
+ */
+const gc_scan_plan_t *gc_scan_plan(struct __go_type_descriptor *type)
+{
+    static gc_scan_plan_t *last;
+
+    if (last && last->type == type)
+        return last;
+
+    uint32_t hash = ((uint32_t)(uintptr_t)type >> 3) * 0x9E3779B1u;
+    for (uint32_t probe = 0; probe < GC_SCAN_PLAN_BUCKETS; probe++)
+    {
+        gc_scan_plan_t **slot = &plan_table[(hash + probe) % GC_SCAN_PLAN_BUCKETS];
+
+        if (*slot && (*slot)->type == type)
+            return last = *slot;
+        if (*slot)
+            continue;
+
+        if (!in_ram(type) || type->__ptrdata == 0)
+            return NULL;
+
+        /* Built by a later collection outside the interrupt */
+        if (irq_inside_int())
+            return NULL;
+
+        /* Keep a free slot so lookups of unknown types terminate */
+        if (plan_count + 1 >= GC_SCAN_PLAN_BUCKETS)
+            return NULL;
+
+        gc_scan_plan_t *plan = build_plan(type);
+        if (plan)
+        {
+            *slot = plan;
+            plan_count++;
+            last = plan;
+        }
+        return plan;
+    }
+    return NULL;
+}
+
+/* Number of cached plans, for tests */
+uint32_t runtime_gcScanPlans(void) __asm__("_runtime.gcScanPlans");
+uint32_t runtime_gcScanPlans(void)
+{
+    return plan_count;
+}
@@ -1,7 +1,14 @@
 /* libgodc/runtime/gc_semispace.h - copying GC for Dreamcast
+ *
+ * Small objects are bump-allocated in a nursery. A minor collection copies
+ * the nursery survivors into the active semispace (promotion); a full
+ * collection is Cheney's algorithm over the semispace and the nursery.
+ * Built with GC_MARK_COMPACT=1, the full collection instead slides live
+ * objects down within one heap twice the semispace size.
  *
  * WARNING: This GC moves objects. Hardware DMA pointers become stale after
- * collection. Use pvr_mem_malloc() for textures, or disable GC during DMA.
+ * collection. Use gc_alloc_pinned() (runtime.AllocPinned) or
+ * pvr_mem_malloc() for DMA buffers.
  */
 #ifndef GC_SEMISPACE_H
 #define GC_SEMISPACE_H
@@ -22,12 +29,29 @@ void runtime_throw(const char *s) __attribute__((noreturn));
 #endif
 #define GC_TOTAL_HEAP_SIZE (2 * GC_SEMISPACE_SIZE)
 
+/* Mark-compact mode manages a single space the size of both semispaces */
+#if GC_MARK_COMPACT
+#define GC_SPACE_COUNT 1
+#define GC_SPACE_SIZE GC_TOTAL_HEAP_SIZE
+#else
+#define GC_SPACE_COUNT 2
+#define GC_SPACE_SIZE GC_SEMISPACE_SIZE
+#endif
+
 #ifdef GC_LARGE_OBJECT_THRESHOLD_KB
 #define GC_LARGE_OBJECT_THRESHOLD ((GC_LARGE_OBJECT_THRESHOLD_KB) * 1024)
 #else
 #define GC_LARGE_OBJECT_THRESHOLD (64 * 1024) // Default: 64KB
 #endif
 
+#define GC_NURSERY_SIZE ((GC_NURSERY_SIZE_KB) * 1024)
+
+// Large object bytes allocated between forced full collections
+#define GC_LARGE_TRIGGER ((size_t)(GC_LARGE_TRIGGER_KB) * 1024)
+
+// Objects larger than this skip the nursery and go straight to the semispace
+#define GC_NURSERY_MAX_OBJECT (GC_NURSERY_SIZE / 8)
+
 // Alignment: 8 bytes for Go compatibility
 #define GC_ALIGN 8
 #define GC_ALIGN_MASK (GC_ALIGN - 1)
@@ -130,6 +154,39 @@ static inline void *gc_get_user_ptr(gc_header_t *header)
     return (void *)((uint8_t *)header + GC_HEADER_SIZE);
 }
 
+/*
+ * Small-object pages. Pointer-free nursery objects of up to
+ * GC_SMALL_MAX_SIZE bytes (boxed integers, new(int64)) have no header of
+ * their own: they are slots in a page that stores the slot size once. The
+ * page is an ordinary NOSCAN nursery object tagged GC_TAG_SMALL_PAGE, so
+ * nursery walks step over it. A collection that reaches a slot copies it
+ * out as a headered object and leaves the forwarding pointer in the slot,
+ * marked in the page's forwarded bitmap.
+ */
+#define GC_SMALL_PAGE_SIZE 4096
+#define GC_SMALL_MAX_SIZE 16
+#define GC_SMALL_CLASSES (GC_SMALL_MAX_SIZE / GC_ALIGN) // 8- and 16-byte slots
+#define GC_TAG_SMALL_PAGE 0x3F                          // Beyond the Go kinds
+#define GC_SMALL_MAP_WORDS 16                           // Enough for 8-byte slots
+
+typedef struct
+{
+    uint16_t slot_size;
+    uint16_t capacity; // Slots in the page
+    uint16_t used;     // Slots handed out
+    uint16_t unused;
+    uint32_t forwarded[GC_SMALL_MAP_WORDS]; // Slots copied by this collection
+} gc_small_page_t;
+
+_Static_assert((GC_SMALL_PAGE_SIZE - GC_HEADER_SIZE - sizeof(gc_small_page_t)) / GC_ALIGN <=
+                   GC_SMALL_MAP_WORDS * 32,
+               "small page forwarded bitmap too small");
+
+static inline uint8_t *gc_small_slots(gc_small_page_t *page)
+{
+    return (uint8_t *)(page + 1);
+}
+
 /* Semi-Space Heap */
 typedef struct gc_heap
 {
@@ -144,8 +201,40 @@ typedef struct gc_heap
     // Scan pointer for Cheney's algorithm
     uint8_t *scan_ptr; // For copying collection
 
+    // Nursery (young generation) bump allocator
+    uint8_t *nursery;       // Start of nursery
+    uint8_t *nursery_ptr;   // Next nursery allocation point
+    uint8_t *nursery_limit; // End of nursery
+    size_t nursery_size;    // Nursery size in bytes
+
+    // Small-object pages in the nursery
+    gc_small_page_t *small_page[GC_SMALL_CLASSES]; // Current page per slot size
+    uint32_t small_pages;                          // Pages carved since the last reset
+
+    // Object-start maps (see gc_start_map_set)
+    uint32_t *start_map[2];        // One per semi-space
+    uint32_t *nursery_start_map;   // For the nursery
+    uint16_t *start_back[2];       // Block back offsets, one per semi-space
+    uint16_t *nursery_start_back;  // For the nursery
+
+    // Dirty cards of an incremental cycle (see gc_card_mark)
+    uint32_t *card_map[2];      // One per semi-space
+    uint32_t *nursery_card_map; // For the nursery
+
+    // Pre-zeroed memory (gc_prezero_incremental): every byte at or above
+    // both this and the space's bump pointer is known to be zero.
+    uint8_t *clean_from[2];      // One per semi-space
+    uint8_t *nursery_clean_from; // For the nursery
+
+#if GC_MARK_COMPACT
+    // Mark-compact state (see gc_compact in gc_copy.c)
+    uint32_t *mark_map;   // One bit per granule of every live object
+    uint32_t *block_live; // Live bytes below each 256-byte block
+#endif
+
     // Statistics
-    size_t space_size;            // Size of each semi-space
+    size_t space_size;            // Size of each semi-space (or the compacted heap)
+    size_t space_capacity[2];     // Bytes allocated for each space (>= space_size)
     size_t bytes_allocated;       // Bytes currently in use (reset after GC)
     size_t total_bytes_allocated; // Cumulative bytes ever allocated (never decreases)
     uint64_t total_alloc_count;   // Cumulative allocation count (for MemStats.Mallocs)
@@ -156,7 +245,13 @@ typedef struct gc_heap
     uint64_t last_pause_us;  // Last GC pause duration
     uint64_t total_pause_us; // Total time spent in GC
 
-    // Large object tracking
+    // Minor (nursery) collections
+    uint32_t minor_count;          // Number of minor collections
+    size_t bytes_promoted;         // Bytes promoted by last minor GC
+    uint64_t last_minor_pause_us;  // Last minor GC pause duration
+    uint64_t total_minor_pause_us; // Total time spent in minor GC
+
+    // Large object space (live objects, maintained by gc_pinned.c)
     uint32_t large_alloc_count;
     size_t large_alloc_total;
 
@@ -164,6 +259,12 @@ typedef struct gc_heap
     bool initialized;
     bool gc_in_progress;
 
+    // Incremental collection (gc_collect_step)
+    bool incremental;  // Start incremental cycles instead of full pauses
+    bool cycle_active; // A cycle is between gc_collect_start and finish
+    bool depth_first;  // Scan just-copied objects first (gc_scan_to_space)
+    uint8_t *from_end; // End of the used from-space when the cycle started
+
     /*
      * Incremental cache invalidation state.
      *
@@ -182,6 +283,144 @@ typedef struct gc_heap
 // Global heap instance
 extern gc_heap_t gc_heap;
 
+/* Remembered Set
+ *
+ * Old-to-young pointers are the only roots a minor GC cannot find by
+ * scanning stacks and globals. The write barrier records the address of
+ * every semispace, mature, pinned or arena slot that receives a nursery
+ * pointer.
+ * Objects allocated directly outside the nursery are recorded whole
+ * (tagged with GC_REMSET_OBJECT) because their initializing stores may not
+ * go through the barrier. On overflow the next minor GC scans the whole
+ * semispace, the mature region and every pinned object.
+ */
+#define GC_REMSET_OBJECT 1
+
+typedef struct gc_remset
+{
+    uintptr_t entries[GC_REMSET_ENTRIES]; // Slot addresses or tagged objects
+    uint32_t count;
+    bool overflow;
+} gc_remset_t;
+
+extern gc_remset_t gc_remset;
+
+void gc_remember(uintptr_t entry);
+void gc_remember_range(void *dst, size_t size);
+
+/*
+ * Object-start maps.
+ *
+ * One bit per GC_ALIGN granule, set for the granule holding each object
+ * header. Allocation and the copy loop set bits; a space's map is cleared
+ * once the space has been evacuated. The collector finds the object
+ * containing any address from it, so interior pointers (sub-slices,
+ * &arr[i], substrings) keep their object alive.
+ *
+ * Each map word covers a GC_START_BLOCK-byte block. A side table of back
+ * offsets holds, for every block an object runs into, how many blocks
+ * back that object's header is, so a lookup reads at most two map words
+ * whatever the object size. Stale offsets are harmless: the lookup checks
+ * that the object it lands on really spans the address.
+ */
+#define GC_START_MAP_BYTES(space_bytes) ((space_bytes) / GC_ALIGN / 8)
+#define GC_START_BLOCK (GC_ALIGN * 32)
+#define GC_START_BACK_BYTES(space_bytes) ((space_bytes) / GC_START_BLOCK * sizeof(uint16_t))
+
+static inline void gc_start_map_set(uint32_t *map, uint16_t *back, const uint8_t *base,
+                                    const void *header, size_t size)
+{
+    size_t off = (uintptr_t)header - (uintptr_t)base;
+    size_t g = off / GC_ALIGN;
+    map[g >> 5] |= 1u << (g & 31);
+
+    size_t first = off / GC_START_BLOCK;
+    size_t last = (off + size - 1) / GC_START_BLOCK;
+    for (size_t b = first + 1; b <= last; b++)
+        back[b] = (uint16_t)(b - first);
+}
+
+void gc_start_map_clear(uint32_t *map, const uint8_t *base,
+                        const uint8_t *lo, const uint8_t *hi);
+gc_header_t *gc_start_map_find(const uint32_t *map, const uint16_t *back,
+                               uintptr_t base, uintptr_t addr);
+
+static inline bool gc_in_nursery(const void *ptr)
+{
+    return ((uintptr_t)ptr - (uintptr_t)gc_heap.nursery) < gc_heap.nursery_size;
+}
+
+static inline bool gc_in_old_space(const void *ptr)
+{
+    return ((uintptr_t)ptr - (uintptr_t)gc_heap.space[gc_heap.active_space]) <
+           gc_heap.space_size;
+}
+
+/* The non-moving mature region (gc_pretenure.c); empty until first used */
+extern uint8_t *gc_mature_base;
+extern size_t gc_mature_size;
+
+static inline bool gc_in_mature(const void *ptr)
+{
+    return ((uintptr_t)ptr - (uintptr_t)gc_mature_base) < gc_mature_size;
+}
+
+/* Pinned and large objects (gc_pinned.c). The bounds test also passes
+ * for memory between them. */
+extern uintptr_t gc_pinned_lo; // Lowest pinned user address
+extern uintptr_t gc_pinned_hi; // One past the highest pinned object
+extern size_t gc_pinned_bytes; // Bytes held by pinned objects
+
+static inline bool gc_maybe_pinned(uintptr_t addr)
+{
+    return addr - gc_pinned_lo < gc_pinned_hi - gc_pinned_lo;
+}
+
+/* Frame arenas (gc_arena.c), likewise */
+extern uintptr_t gc_arena_lo; // Lowest arena base
+extern uintptr_t gc_arena_hi; // One past the highest arena limit
+
+static inline bool gc_maybe_arena(uintptr_t addr)
+{
+    return addr - gc_arena_lo < gc_arena_hi - gc_arena_lo;
+}
+
+/*
+ * Dirty cards.
+ *
+ * During an incremental cycle the mutator still writes the from-space
+ * and nursery originals of objects that may already be replicated. The
+ * write barriers mark the GC_CARD_SIZE cards they store into, and
+ * gc_collect_finish() re-copies and rescans only the replicas whose
+ * originals overlap a dirty card.
+ */
+#define GC_CARD_SHIFT 8
+#define GC_CARD_SIZE (1u << GC_CARD_SHIFT)
+#define GC_CARD_MAP_BYTES(space_bytes) ((((space_bytes) >> GC_CARD_SHIFT) + 31) / 32 * 4)
+
+void gc_card_mark(void *dst, size_t size);
+
+/* Call after storing a pointer into *slot from C. */
+static inline void gc_write_barrier(void **slot)
+{
+    if (gc_heap.cycle_active)
+        gc_card_mark(slot, sizeof(void *));
+    if (gc_in_nursery(*slot) &&
+        (gc_in_old_space(slot) || gc_in_mature(slot) || gc_maybe_pinned((uintptr_t)slot) ||
+         gc_maybe_arena((uintptr_t)slot)))
+        gc_remember((uintptr_t)slot);
+}
+
+/* Call after copying pointer-bearing memory into [dst, dst+size) from C. */
+static inline void gc_write_barrier_range(void *dst, size_t size)
+{
+    if (gc_heap.cycle_active)
+        gc_card_mark(dst, size);
+    if (gc_in_old_space(dst) || gc_in_mature(dst) || gc_maybe_pinned((uintptr_t)dst) ||
+        gc_maybe_arena((uintptr_t)dst))
+        gc_remember_range(dst, size);
+}
+
 /* Root Management */
 
 // Maximum number of explicit root pointers
@@ -239,13 +478,45 @@ void gc_init(void);
 //
 void *gc_alloc(size_t size, struct __go_type_descriptor *type)
     __attribute__((returns_nonnull, malloc, warn_unused_result));
+void *gc_alloc_nozero(size_t size, struct __go_type_descriptor *type)
+    __attribute__((returns_nonnull, malloc, warn_unused_result));
 void *gc_alloc_no_gc(size_t size, struct __go_type_descriptor *type)
     __attribute__((returns_nonnull, malloc, warn_unused_result));
+// Pointer-free memory with no type descriptor (boxed scalars)
+void *gc_alloc_noscan(size_t size)
+    __attribute__((returns_nonnull, malloc, warn_unused_result));
 
 /* Collection (Cheney's algorithm) */
 void gc_collect(void);
+void gc_minor_collect(void);
 void gc_collect_if_needed(size_t requested_size);
 
+/*
+ * Incremental collection (replicating Cheney).
+ *
+ * gc_collect_start() flips to the empty semispace and copies the objects
+ * reachable from the roots without updating the roots: the mutator keeps
+ * running on the from-space originals. gc_collect_step() then advances
+ * scan_ptr for at most budget_us, replicating more of the live graph.
+ * gc_collect_finish() is the only other pause: it rescans the roots with
+ * updating, refreshes the replicas from their originals (the mutator may
+ * have written an original since it was copied), drains the grey region
+ * and switches the mutator to the new space. Only replicas on cards the
+ * write barrier dirtied are rescanned; the rest just take their scalar
+ * words back, since gccgo does not barrier scalar stores.
+ *
+ * A minor GC or runtime.GC during a cycle finishes it first, so a cycle
+ * should complete within one nursery fill. Semispace allocations made
+ * during a cycle are placed at the top of to-space (alloc_limit moves
+ * down) and evacuated by the finish along with from-space.
+ *
+ * gc_collect_step() returns true while the cycle still has work. It never
+ * finishes a cycle from interrupt context (e.g. the vblank handler).
+ */
+void gc_collect_start(void);
+bool gc_collect_step(uint32_t budget_us);
+void gc_collect_finish(void);
+
 /* GC inhibit for map operations (prevents moving GC during critical sections) */
 void gc_inhibit_collection(void);
 void gc_allow_collection(void);
@@ -279,6 +550,9 @@ bool gc_invalidate_incremental(void);
  *         // ... other vblank work ...
  *     }
  *
+ * Budget left over after invalidation advances an active incremental
+ * collection (see gc_collect_step), or else pre-zeroes free memory.
+ *
  * @param budget_us  Maximum microseconds to spend (0 = one chunk only)
  * @return           Remaining chunks to process (0 = all done)
  */
@@ -293,6 +567,20 @@ int gc_invalidate_on_vblank(uint32_t budget_us);
  */
 bool gc_invalidation_pending(void);
 
+/*
+ * gc_prezero_incremental - Zero one chunk of free heap memory.
+ *
+ * Free memory is dirty after a collection: the nursery and the tail of the
+ * active space hold dead objects, and the idle semispace holds the last
+ * cycle's from-space. Clearing it ahead of time (from the top down, so the
+ * clean part stays contiguous) lets gc_alloc() skip its memset. Runs from
+ * the same places as invalidation, and from vblank; the idle semispace is
+ * cleared only once its invalidation is done.
+ *
+ * @return true if there's more work to do, false if done
+ */
+bool gc_prezero_incremental(void);
+
 // Root management
 void gc_add_root(void **root_ptr);
 void gc_remove_root(void **root_ptr);
@@ -319,6 +607,199 @@ void *runtime_makeslice(struct __go_type_descriptor *elem_type, intptr_t len, in
 void *gc_external_alloc(size_t size);
 void gc_external_free(void *ptr);
 
+/* Pinned Allocation (gc_pinned.c) */
+
+// GC-managed objects that never move: safe to hand to DMA or the store
+// queues. A full GC marks the pinned objects it reaches (any pointer into
+// them counts) and frees the rest. Exposed to Go as runtime.AllocPinned.
+
+void *gc_alloc_pinned(size_t size, struct __go_type_descriptor *type);
+
+// Large object space: gc_alloc() sends objects above
+// GC_LARGE_OBJECT_THRESHOLD here. gc_pinned_free() releases a pinned or
+// large object early (runtime.FreeExternal) and returns false for others.
+void *gc_alloc_large(size_t size, struct __go_type_descriptor *type, bool noscan);
+bool gc_pinned_free(void *obj);
+
+// Collector interface
+void gc_pinned_begin_mark(void);    // Start marking (full GC)
+void gc_pinned_mark(uintptr_t addr); // Mark the object containing addr
+void *gc_pinned_pop_grey(void);     // Next marked object to scan, or NULL
+void *gc_pinned_object(int index);  // Iterate all objects
+bool gc_pinned_contains(uintptr_t addr); // Inside a live pinned object
+void gc_pinned_sweep(void);         // Free unmarked objects, end marking
+
+/* GC Trace (gc_trace.c) */
+
+// Every collection pause gets a record in a ring of GC_TRACE_ENTRIES.
+// Read from Go with runtime.ReadGCTrace; runtime.SetGCTrace(true) also
+// prints one line per record. All fields are uint32 so a Go struct of
+// the same shape can mirror the record.
+
+typedef enum
+{
+    GC_TRACE_FULL,         // gc_collect (copying or mark-compact)
+    GC_TRACE_MINOR,        // gc_minor_collect
+    GC_TRACE_CYCLE_START,  // gc_collect_start
+    GC_TRACE_CYCLE_FINISH, // gc_collect_finish
+} gc_trace_kind_t;
+
+typedef enum
+{
+    GC_PHASE_ROOTS,      // Explicit roots (gc_add_root)
+    GC_PHASE_GLOBALS,    // Compiler roots (gc_scan_compiler_roots)
+    GC_PHASE_STACKS,     // Current and parked goroutine stacks
+    GC_PHASE_SCAN,       // Cheney loop, remembered set, mark/compact work
+    GC_PHASE_INVALIDATE, // Deferred cache invalidation, charged afterwards
+    GC_PHASE_COUNT
+} gc_phase_t;
+
+typedef struct
+{
+    uint32_t seq;      // Record number, counting every kind
+    uint32_t kind;     // gc_trace_kind_t
+    uint32_t start_us; // timer_us_gettime64() at the start (low 32 bits)
+    uint32_t total_us; // Whole pause
+    uint32_t phase_us[GC_PHASE_COUNT];
+    uint32_t bytes_copied;   // Copied, promoted or moved
+    uint32_t objects_copied; // Objects in bytes_copied
+    uint32_t heap_before;    // Semispace + nursery + pinned bytes in use
+    uint32_t heap_after;
+} gc_trace_record_t;
+
+gc_trace_record_t *gc_trace_begin(gc_trace_kind_t kind, uint64_t start_us);
+void gc_trace_end(gc_trace_record_t *rec, uint64_t elapsed_us);
+void gc_trace_charge_invalidate(uint32_t us); // Adds to the GC that queued it
+size_t gc_heap_in_use(void);
+
+/* Frame Arenas (gc_arena.c) */
+
+// A bump region outside the heap, reset all at once. Each goroutine has
+// its own current arena (G.arena); while it is set, gc_alloc() takes
+// memory from it first. Exposed to Go as runtime.NewArena, SetArena,
+// ResetArena, FreeArena and ArenaUsed.
+typedef struct gc_arena
+{
+    uint8_t *base;    // Start of the region (memalign)
+    uint8_t *ptr;     // Next allocation point
+    uint8_t *limit;   // End of the region
+    uint8_t *scanned; // Objects below were there at the last collection
+} gc_arena_t;
+
+// An object from the running goroutine's arena, or NULL (full) to
+// allocate from the heap instead
+void *gc_arena_alloc(gc_arena_t *arena, size_t size, struct __go_type_descriptor *type,
+                     bool noscan, bool needzero);
+// Call scan on every pointerful arena object (a root region), or for a
+// minor GC only on those allocated since the last collection: the write
+// barrier remembers nursery pointers stored into the older ones
+void gc_arena_scan(void (*scan)(void *obj), bool minor);
+void gc_arena_collected(void);           // Nursery emptied: all objects are old
+bool gc_arena_contains(uintptr_t addr);  // Inside an allocated arena object
+
+/* Object Pools (gc_pool.c) */
+
+// Free lists scanned as roots. Each full collection (or cycle start) calls
+// gc_pool_rotate(): the previous victims are dropped and the pooled objects
+// become the victims. Exposed to Go as runtime.NewPool, PoolGet, PoolPut.
+void gc_pool_rotate(void);
+void gc_pool_scan(void (*update)(void **field));
+
+/* Heap Walking and Snapshots (gc_copy.c, gc_snapshot.c) */
+
+// Read-only walks with the collector's own scanners: visit gets every root
+// slot, or every pointer field of obj. Nothing may allocate meanwhile.
+// gc_snapshot_write() collects and streams the object graph to a file for
+// tools/heapsnap. Exposed to Go as runtime.WriteHeapSnapshot.
+void gc_walk_roots(void (*visit)(void **field));
+void gc_walk_object(void *obj, void (*visit)(void **field));
+bool gc_snapshot_write(const char *path);
+
+/* Heap Size and Memory Limit (gc_resize.c) */
+
+// gc_heap_resize() sets the initial space size before gc_init(), and
+// resizes between collections after it. The memory limit is a soft bound
+// on gc_heap_in_use(); a collection that leaves the heap near it (or near
+// the end of the semispace) is a low-memory event. Exposed to Go as
+// runtime.SetHeapSize, debug.SetMemoryLimit and runtime.NotifyLowMemory.
+bool gc_heap_resize(size_t space_size);
+size_t gc_memlimit_goal(void);           // Semispace in use the limit allows, SIZE_MAX = none
+void gc_memlimit_collected(void);        // After each full collection or finish
+void gc_heap_exhausted(size_t request); // Before gc_alloc() throws "out of memory"
+void gc_set_low_memory_callback(void (*fn)(size_t in_use, size_t limit));
+
+/* Pretenuring (gc_pretenure.c) */
+
+// The allocation site is the type descriptor. A full collection charges
+// each object it copies out of the old semispace to its type; types whose
+// tenured survivors stay above GC_PRETENURE_MIN_KB for GC_PRETENURE_GCS
+// full collections are pretenured into the non-moving mature region, both
+// at allocation and when a collection next copies them. Mature objects are
+// marked and swept like pinned ones. gc_pretenure_filter holds one bit per
+// (type >> 3) & 255 of the pretenured types, so gc_alloc() only looks a
+// type up when its bit is set.
+extern uint32_t gc_pretenure_filter[8];
+extern size_t gc_mature_bytes; // Bytes held by mature objects
+
+static inline bool gc_pretenure_hit(const struct __go_type_descriptor *type)
+{
+    uint32_t i = ((uintptr_t)type >> 3) & 255;
+    return (gc_pretenure_filter[i >> 5] >> (i & 31)) & 1;
+}
+
+void *gc_pretenure_alloc(size_t size, struct __go_type_descriptor *type,
+                         bool noscan, bool needzero); // NULL: allocate normally
+void *gc_pretenure_copy(gc_header_t *header);         // Move a survivor, or NULL
+void gc_pretenure_survivor(struct __go_type_descriptor *type, size_t size);
+void gc_pretenure_collected(void); // After each full collection or finish
+
+// Collector interface
+void gc_mature_begin_mark(void);    // Start marking (full GC)
+void gc_mature_mark(uintptr_t addr); // Mark the object containing addr
+void *gc_mature_pop_grey(void);     // Next object to scan, or NULL
+void gc_mature_walk(void (*fn)(void *obj)); // Every allocated object
+void gc_mature_sweep(void);         // Free unmarked objects, end marking
+
+/* Scan Plans (gc_scan_plan.c) */
+
+// Pointer layout of a type, built once from its gcdata bitmap or GC program.
+// Either `count` byte offsets, or (bitmap != NULL) an nwords-bit pointer
+// bitmap for types with more than GC_SCAN_PLAN_MAX_OFFSETS pointers.
+typedef struct
+{
+    struct __go_type_descriptor *type;
+    uint32_t count;        // Pointer words per element
+    uint32_t nwords;       // ptrdata / sizeof(void *)
+    const uint8_t *bitmap; // NULL: use offsets
+    uint32_t offsets[];    // Byte offsets of the pointer words
+} gc_scan_plan_t;
+
+const gc_scan_plan_t *gc_scan_plan(struct __go_type_descriptor *type);
+
+/* Pacer (gc_pacer.c) */
+
+// gc_pacer_trigger() is the semispace usage that collects mid-frame: the
+// gc_percent threshold, lowered towards the heap goal if one is set.
+// gc_pacer_frame_end() collects earlier, at a frame boundary, within the
+// pause budget. Exposed to Go as runtime.GCFrameEnd, SetGCPauseBudget and
+// SetGCHeapGoal.
+size_t gc_pacer_trigger(void);
+uint32_t gc_pacer_predict_pause(void);
+void gc_pacer_collected(gc_trace_kind_t kind);
+bool gc_pacer_frame_end(void);
+
+/* Allocation Profiler (gc_profile.c) */
+
+// gc_alloc() subtracts each request from gc_profile_countdown and calls
+// gc_profile_sample() when it runs out. Disabled, the countdown is
+// SIZE_MAX, so the fast path costs one compare. Exposed to Go as
+// runtime.SetAllocProfileRate and runtime.WriteAllocProfile.
+extern size_t gc_profile_countdown;
+
+void gc_profile_sample(size_t size, struct __go_type_descriptor *type);
+void gc_profile_set_rate(size_t rate); // Bytes between samples, 0 = off
+bool gc_profile_write(const char *path);
+
 #if GC_DEBUG
 void gc_verify_heap(void);
 void gc_dump_object(void *ptr);
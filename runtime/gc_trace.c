@@ -0,0 +1,112 @@
+/* libgodc/runtime/gc_trace.c - GC trace ring
+ *
+ * The collector fills one gc_trace_record_t per pause (gc_copy.c times the
+ * root phases and counts copies). The ring keeps the last GC_TRACE_ENTRIES
+ * so a game can pull them after a slow frame, and runtime.SetGCTrace
+ * prints each one as it completes:
+ *
+ *   gc 7 full @81234ms: roots 2 + globals 35 + stacks 96 + scan 612 = 745 us,
+ *       1840 objs 61 KB copied, 1906 -> 96 KB
+ */
+
+#include "gc_semispace.h"
+#include "runtime.h"
+#include <string.h>
+#include <kos/dbglog.h>
+
+static gc_trace_record_t trace_ring[GC_TRACE_ENTRIES];
+static uint32_t trace_seq;            /* Records started (seq of the newest) */
+static uint32_t trace_invalidate_seq; /* Record that queued the pending invalidation */
+static bool trace_print;
+
+static const char *const trace_kind_names[] = {"full", "minor", "start", "finish"};
+
+size_t gc_heap_in_use(void)
+{
+    return (size_t)(gc_heap.alloc_ptr - gc_heap.space[gc_heap.active_space]) +
+           (size_t)(gc_heap.nursery_ptr - gc_heap.nursery) + gc_pinned_bytes +
+           gc_mature_bytes;
+}
+
+gc_trace_record_t *gc_trace_begin(gc_trace_kind_t kind, uint64_t start_us)
+{
+    gc_trace_record_t *rec = &trace_ring[trace_seq % GC_TRACE_ENTRIES];
+
+    memset(rec, 0, sizeof(*rec));
+    rec->seq = ++trace_seq;
+    rec->kind = kind;
+    rec->start_us = (uint32_t)start_us;
+    rec->heap_before = gc_heap_in_use();
+    return rec;
+}
+
+void gc_trace_end(gc_trace_record_t *rec, uint64_t elapsed_us)
+{
+    rec->total_us = (uint32_t)elapsed_us;
+    rec->heap_after = gc_heap_in_use();
+
+    /* Whatever the root phases did not use went to scanning and copying */
+    uint32_t roots = rec->phase_us[GC_PHASE_ROOTS] + rec->phase_us[GC_PHASE_GLOBALS] +
+                     rec->phase_us[GC_PHASE_STACKS];
+    rec->phase_us[GC_PHASE_SCAN] = rec->total_us > roots ? rec->total_us - roots : 0;
+
+    if (gc_heap.pending_invalidate_space &&
+        (rec->kind == GC_TRACE_FULL || rec->kind == GC_TRACE_CYCLE_FINISH))
+        trace_invalidate_seq = rec->seq;
+
+    if (trace_print)
+    {
+        dbglog(DBG_INFO, "gc %lu %s @%lums: roots %lu + globals %lu + stacks %lu + scan %lu = %lu us, "
+                         "%lu objs %lu KB copied, %lu -> %lu KB\n",
+               (unsigned long)rec->seq, trace_kind_names[rec->kind],
+               (unsigned long)(rec->start_us / 1000),
+               (unsigned long)rec->phase_us[GC_PHASE_ROOTS],
+               (unsigned long)rec->phase_us[GC_PHASE_GLOBALS],
+               (unsigned long)rec->phase_us[GC_PHASE_STACKS],
+               (unsigned long)rec->phase_us[GC_PHASE_SCAN],
+               (unsigned long)rec->total_us,
+               (unsigned long)rec->objects_copied,
+               (unsigned long)(rec->bytes_copied / 1024),
+               (unsigned long)(rec->heap_before / 1024),
+               (unsigned long)(rec->heap_after / 1024));
+    }
+}
+
+/* Invalidation of the old semispace runs after the pause, in slices */
+void gc_trace_charge_invalidate(uint32_t us)
+{
+    if (trace_invalidate_seq == 0)
+        return;
+
+    gc_trace_record_t *rec = &trace_ring[(trace_invalidate_seq - 1) % GC_TRACE_ENTRIES];
+    if (rec->seq == trace_invalidate_seq)
+        rec->phase_us[GC_PHASE_INVALIDATE] += us;
+}
+
+/* runtime.SetGCTrace - print a line per collection (like GODEBUG=gctrace=1).
+ * Returns the previous setting. */
+bool runtime_SetGCTrace(bool enabled) __asm__("_runtime.SetGCTrace");
+bool runtime_SetGCTrace(bool enabled)
+{
+    bool old = trace_print;
+    trace_print = enabled;
+    return old;
+}
+
+/* runtime.ReadGCTrace - copy the newest records, oldest first, into a
+ * slice of structs laid out like gc_trace_record_t (13 uint32 fields).
+ * Returns how many were copied. */
+intptr_t runtime_ReadGCTrace(GoSlice buf) __asm__("_runtime.ReadGCTrace");
+intptr_t runtime_ReadGCTrace(GoSlice buf)
+{
+    uint32_t avail = trace_seq < GC_TRACE_ENTRIES ? trace_seq : GC_TRACE_ENTRIES;
+    uint32_t n = buf.__count < (intptr_t)avail ? (uint32_t)buf.__count : avail;
+    gc_trace_record_t *out = buf.__values;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t seq = trace_seq - n + 1 + i;
+        out[i] = trace_ring[(seq - 1) % GC_TRACE_ENTRIES];
+    }
+    return (intptr_t)n;
+}
@@ -62,6 +62,14 @@ typedef struct G {
     int defer_depth;
     uintptr_t startpc;
     struct G *freeLink;
+    uint16_t *gc_stack_slots;
+    uint16_t gc_stack_nslots;
+    bool gc_stack_clean;
+    uint32_t stack_peak;
+    uint32_t spawn_stack_size;
+    uint8_t sched_class;
+    uint64_t deadline_us;
+    struct gc_arena *arena;
 } G;
 
 #define OFFSET(name, type, field) \
@@ -3,6 +3,7 @@
 #include "runtime.h"
 #include "type_descriptors.h"
 #include "map_dreamcast.h"
+#include "gc_semispace.h"
 #include <string.h>
 
 void *__go_construct_map(const struct __go_map_type *type,
@@ -26,7 +27,10 @@ void *__go_construct_map(const struct __go_map_type *type,
 
         void *val_slot = runtime_mapassign(mt, h, (void *)key);
         if (val_slot)
+        {
             memcpy(val_slot, val, val_size);
+            gc_write_barrier_range(val_slot, val_size);
+        }
 
         entry_ptr += entry_size;
     }
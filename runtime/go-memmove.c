@@ -3,6 +3,7 @@
 #include <string.h>
 #include <stdint.h>
 #include "type_descriptors.h"
+#include "gc_semispace.h"
 
 void runtime_memmove(void *dst, void *src, uintptr_t n)
 {
@@ -19,7 +20,11 @@ void runtime_typedmemmove(void *typ, void *dst, void *src)
     struct __go_type_descriptor *td = (struct __go_type_descriptor *)typ;
     uintptr_t size = td->__size;
     if (size > 0)
+    {
         runtime_memmove(dst, src, size);
+        if (td->__ptrdata != 0)
+            gc_write_barrier_range(dst, td->__ptrdata);
+    }
 }
 
 void __go_memmove(void *dst, void *src, uintptr_t n) __attribute__((alias("runtime_memmove")));
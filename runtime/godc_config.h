@@ -2,16 +2,132 @@
 #ifndef GODC_CONFIG_H
 #define GODC_CONFIG_H
 
-/* GC heap size (each semispace) */
+/* GC heap size (each semispace) at init; runtime.SetHeapSize changes it */
 #ifndef GC_SEMISPACE_SIZE_KB
 #define GC_SEMISPACE_SIZE_KB 2048
 #endif
 
-/* Large objects bypass GC heap */
+/* Largest size running out of memory may grow the heap to (0 = never) */
+#ifndef GC_SEMISPACE_MAX_KB
+#define GC_SEMISPACE_MAX_KB 0
+#endif
+
+/* Soft limit on heap bytes in use (0 = none; debug.SetMemoryLimit), and
+ * the percentage of it, or of the semispace, that is low memory */
+#ifndef GC_MEMORY_LIMIT_KB
+#define GC_MEMORY_LIMIT_KB 0
+#endif
+#ifndef GC_LOW_MEMORY_PERCENT
+#define GC_LOW_MEMORY_PERCENT 90
+#endif
+
+/* Full GC compacts one heap of both semispaces in place instead of copying
+ * between them (make GC_MARK_COMPACT=1) */
+#ifndef GC_MARK_COMPACT
+#define GC_MARK_COMPACT 0
+#endif
+
+/* Nursery (young generation) in front of the semispaces */
+#ifndef GC_NURSERY_SIZE_KB
+#define GC_NURSERY_SIZE_KB 256
+#endif
+
+/* Remembered set: old-to-young pointer slots recorded by the write barrier */
+#ifndef GC_REMSET_ENTRIES
+#define GC_REMSET_ENTRIES 4096
+#endif
+
+/* Incremental collection: spread major GC across scheduler/vblank slack */
+#ifndef GC_INCREMENTAL
+#define GC_INCREMENTAL 0
+#endif
+#ifndef GC_IDLE_STEP_US
+#define GC_IDLE_STEP_US 500
+#endif
+
+/* Copy order: depth-first keeps children next to their parents, using a
+ * stack of GC_DFS_STACK_ENTRIES copied-but-unscanned objects */
+#ifndef GC_COPY_DEPTH_FIRST
+#define GC_COPY_DEPTH_FIRST 0
+#endif
+#ifndef GC_DFS_STACK_ENTRIES
+#define GC_DFS_STACK_ENTRIES 64
+#endif
+
+/* Large objects skip the semispaces (non-moving large object space) */
 #ifndef GC_LARGE_OBJECT_THRESHOLD_KB
 #define GC_LARGE_OBJECT_THRESHOLD_KB 64
 #endif
 
+/* Full GC after this much large object allocation */
+#ifndef GC_LARGE_TRIGGER_KB
+#define GC_LARGE_TRIGGER_KB GC_SEMISPACE_SIZE_KB
+#endif
+
+/* Frame arenas (runtime.NewArena) that can exist at once */
+#ifndef GC_MAX_ARENAS
+#define GC_MAX_ARENAS 8
+#endif
+
+/* Object pools (runtime.NewPool): objects each free list can hold */
+#ifndef GC_POOL_ENTRIES
+#define GC_POOL_ENTRIES 64
+#endif
+
+/* Scan plans: cached types, and the most pointer offsets a plan lists
+ * before it keeps a bitmap instead */
+#ifndef GC_SCAN_PLAN_BUCKETS
+#define GC_SCAN_PLAN_BUCKETS 512
+#endif
+#ifndef GC_SCAN_PLAN_MAX_OFFSETS
+#define GC_SCAN_PLAN_MAX_OFFSETS 64
+#endif
+
+/* Pacer: longest full pause a frame boundary may take (runtime.GCFrameEnd),
+ * and semispace bytes in use to collect at (0 = gc_percent trigger only) */
+#ifndef GC_PAUSE_BUDGET_US
+#define GC_PAUSE_BUDGET_US 2000
+#endif
+#ifndef GC_HEAP_GOAL_KB
+#define GC_HEAP_GOAL_KB 0
+#endif
+
+/* GC trace ring: most recent collection records kept */
+#ifndef GC_TRACE_ENTRIES
+#define GC_TRACE_ENTRIES 32
+#endif
+
+/* Allocation profiler: distinct (type, call stack) records and frames kept */
+#ifndef GC_PROFILE_BUCKETS
+#define GC_PROFILE_BUCKETS 512
+#endif
+#ifndef GC_PROFILE_DEPTH
+#define GC_PROFILE_DEPTH 8
+#endif
+
+/* Pretenuring: a non-moving mature region of GC_MATURE_SIZE_KB (0 = off)
+ * for types whose objects keep surviving full collections: at least
+ * GC_PRETENURE_MIN_KB tenured survivors in GC_PRETENURE_GCS full GCs in a
+ * row. GC_PRETENURE_SITES types are tracked (a power of two). */
+#ifndef GC_MATURE_SIZE_KB
+#define GC_MATURE_SIZE_KB 512
+#endif
+#ifndef GC_PRETENURE_SITES
+#define GC_PRETENURE_SITES 64
+#endif
+#ifndef GC_PRETENURE_MIN_KB
+#define GC_PRETENURE_MIN_KB 4
+#endif
+#ifndef GC_PRETENURE_GCS
+#define GC_PRETENURE_GCS 2
+#endif
+
+/* Stack scan cache: heap pointer slots remembered per parked goroutine,
+ * so one that has not run since the last GC is not rescanned (0 = off) */
+#ifndef GC_STACK_SLOT_CACHE
+#define GC_STACK_SLOT_CACHE 64
+#endif
+
 /* Goroutine stack size */
 #ifndef GOROUTINE_STACK_SIZE
 #define GOROUTINE_STACK_SIZE (64 * 1024)
@@ -34,6 +150,34 @@
 #define STACK_GUARD_SIZE 256
 #endif
 
+/* Goroutines start with GOROUTINE_STACK_INITIAL bytes of stack and are
+ * moved to the next size class (8KB, 32KB, 64KB), up to
+ * GOROUTINE_STACK_SIZE, once half of it is in use (stack.c).
+ * GOROUTINE_STACK_SIZE gives fixed stacks. */
+#ifndef GOROUTINE_STACK_INITIAL
+#define GOROUTINE_STACK_INITIAL STACK_SIZE_SMALL
+#endif
+
+/* Gs, with their TLS block and stack segment header, are allocated
+ * GOROUTINE_SLAB_SLOTS at a time (proc.c); the table of all Gs starts
+ * with room for ALLGS_INITIAL and doubles */
+#ifndef GOROUTINE_SLAB_SLOTS
+#define GOROUTINE_SLAB_SLOTS 16
+#endif
+#ifndef ALLGS_INITIAL
+#define ALLGS_INITIAL 64
+#endif
+
+/* Paint goroutine stacks so their deepest use can be measured when they
+ * exit; runtime.PrintStackProfile lists the peaks per entry function,
+ * up to STACK_PROFILE_ENTRIES of them */
+#ifndef GOROUTINE_STACK_PAINT
+#define GOROUTINE_STACK_PAINT 0
+#endif
+#ifndef STACK_PROFILE_ENTRIES
+#define STACK_PROFILE_ENTRIES 64
+#endif
+
 /* Defer/panic limits */
 #ifndef MAX_DEFER_DEPTH
 #define MAX_DEFER_DEPTH 1000
@@ -52,6 +196,13 @@
 #define TIMER_PROCESS_MAX 1000
 #endif
 
+/* A goroutine woken by a channel operation runs next, switched to
+ * directly when the waker parks or yields; after SCHED_RUNNEXT_MAX of
+ * those in a row the run queue gets a turn (0 = plain FIFO) */
+#ifndef SCHED_RUNNEXT_MAX
+#define SCHED_RUNNEXT_MAX 16
+#endif
+
 /* Dead goroutine cleanup */
 #ifndef DEAD_G_GRACE_GENERATIONS
 #define DEAD_G_GRACE_GENERATIONS 2
@@ -86,6 +237,10 @@
 #define TYPE_RECURSE_MAX_DEPTH 32
 #endif
 
+/* GC pointer maps for the runtime's C records: bit i is set if word i of
+ * the record may hold a heap pointer */
+#define GC_PTRMAP_BIT(type, field) (1ull << (offsetof(type, field) / sizeof(void *)))
+
 /* Runtime assertions */
 extern void runtime_throw(const char *msg) __attribute__((noreturn));
 
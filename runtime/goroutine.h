@@ -57,7 +57,7 @@ typedef struct stack_segment {
     uint8_t _pad[3];
 } stack_segment_t;
 
-/* Stack size - fixed per goroutine */
+/* Stack sizes */
 #include "godc_config.h"
 
 /* Goroutine status */
@@ -75,6 +75,15 @@ typedef enum {
 /* G flags */
 #define G_FLAG2_GOEXITING (1 << 0)
 #define G_FLAG2_IN_PANIC  (1 << 1)
+#define G_FLAG2_MORESTACK (1 << 2) /* Switched out to have its stack grown */
+
+/* Scheduling classes, highest priority first (scheduler.c) */
+typedef enum {
+    SCHED_REALTIME = 0,
+    SCHED_NORMAL = 1,
+    SCHED_BACKGROUND = 2,
+    SCHED_CLASSES = 3,
+} SchedClass;
 
 /* Wait reasons */
 typedef enum {
@@ -135,12 +144,47 @@ typedef struct G {
 
     /* Free list */
     struct G *freeLink;
+
+    /* GC stack scan cache (gc_copy.c): stack words that held heap
+     * pointers, as word offsets from context.sp. Valid while gc_stack_clean,
+     * which the scheduler clears whenever the G runs or is woken. */
+    uint16_t *gc_stack_slots;
+    uint16_t gc_stack_nslots;
+    bool gc_stack_clean;
+
+    /* Deepest use of segments it has been moved off (GOROUTINE_STACK_PAINT) */
+    uint32_t stack_peak;
+
+    /* Stack size for the next goroutine it creates (runtime.SetSpawnStack) */
+    uint32_t spawn_stack_size;
+
+    /* Scheduling class, and for realtime goroutines an absolute deadline
+     * for the next run in timer_us_gettime64() time (0 = none) */
+    uint8_t sched_class;
+    uint64_t deadline_us;
+
+    /* Frame arena its allocations come from first (gc_arena.c), or NULL */
+    struct gc_arena *arena;
 } G;
 
 /* Verify ABI-critical offsets */
 _Static_assert(offsetof(G, _panic) == 0, "G._panic MUST be at offset 0");
 _Static_assert(offsetof(G, _defer) == 4, "G._defer MUST be at offset 4");
 
+/* G words the collector updates (gc_copy.c). The saved callee-saved
+ * registers are ambiguous, like stack words; the rest of the G (ids,
+ * status, stack bounds, links to malloc'd Gs and sudogs) never points
+ * into the heap. */
+#define G_GC_PTRMAP                                                     \
+    (GC_PTRMAP_BIT(G, _panic) | GC_PTRMAP_BIT(G, _defer) |              \
+     GC_PTRMAP_BIT(G, param) | GC_PTRMAP_BIT(G, checkpoint) |           \
+     GC_PTRMAP_BIT(G, context.r8) | GC_PTRMAP_BIT(G, context.r9) |      \
+     GC_PTRMAP_BIT(G, context.r10) | GC_PTRMAP_BIT(G, context.r11) |    \
+     GC_PTRMAP_BIT(G, context.r12) | GC_PTRMAP_BIT(G, context.r13) |    \
+     GC_PTRMAP_BIT(G, context.r14))
+
+_Static_assert(sizeof(G) <= 64 * sizeof(void *), "G_GC_PTRMAP must cover G");
+
 /* Sudog - goroutine waiting on channel */
 typedef struct sudog {
     G *g;
@@ -155,6 +199,10 @@ typedef struct sudog {
     struct hchan *c;
 } sudog;
 
+/* Sudogs are malloc'd and reached only through G.waiting and waitlink,
+ * so the collector updates these through the G */
+#define SUDOG_GC_PTRMAP (GC_PTRMAP_BIT(sudog, elem) | GC_PTRMAP_BIT(sudog, c))
+
 /* Context switch functions (runtime_sh4_minimal.S) */
 int __go_getcontext(sh4_context_t *ctx);
 void __go_setcontext(const sh4_context_t *ctx) __attribute__((noreturn));
@@ -178,6 +226,7 @@ void tls_free(tls_block_t *tls);
 void schedule(void);
 void gopark(bool (*unlockf)(void *), void *lock, WaitReason reason);
 void goready(G *gp);
+void goready_next(G *gp);
 void goroutine_yield_to_scheduler(void);
 void scheduler_init(void);
 void scheduler_start(void);
@@ -188,19 +237,31 @@ extern sh4_context_t sched_context;
 
 /* Goroutine creation */
 G *__go_go(void (*fn)(void *), void *arg);
+G *__go_go_stack(void (*fn)(void *), void *arg, size_t stack_size);
 void runtime_goexit(void) __attribute__((noreturn));
 void runtime_goexit_internal(void) __attribute__((noreturn));
 G *runtime_getg(void);
 extern void runtime_checkdefer(bool *frame);
 
 /* Stack management */
-stack_segment_t *stack_alloc(size_t size);
-void stack_free(stack_segment_t *seg);
-stack_segment_t *stack_pool_get(size_t min_size);
-void stack_pool_put(stack_segment_t *seg);
+void *stack_alloc(size_t size);
+void stack_free(void *base, size_t size);
 void stack_pool_preallocate(void);
 bool goroutine_stack_init(G *gp, size_t stack_size);
 void goroutine_stack_free(G *gp);
+void goroutine_morestack(void);       /* Grow the running goroutine's stack */
+bool goroutine_stack_check(G *gp);    /* After a switch out: true to resume */
+bool goroutine_stack_handoff_ok(G *gp); /* Before a direct switch: false to use the scheduler */
+void goroutine_stack_profile(G *gp);  /* Record gp's peak as it exits */
+
+/* Below its stack guard: more than half of a growable stack is in use,
+ * or a full-size one is about to overflow */
+static inline bool goroutine_stack_low(void)
+{
+    register uintptr_t sp __asm__("r15");
+    tls_block_t *tls = current_tls;
+    return tls && sp < (uintptr_t)tls->stack_guard;
+}
 
 /* Split-stack ABI stubs */
 void *__splitstack_getcontext(void *context[10]);
@@ -1449,8 +1449,7 @@ void *runtime_convTnoptr(struct __go_type_descriptor *t, void *v)
     if (!t || !v)
         return NULL;
 
-    // Allocate without pointer scanning (t = NULL means NOSCAN)
-    void *x = gc_alloc(t->__size, NULL);
+    void *x = gc_alloc_noscan(t->__size);
     if (x)
     {
         memcpy(x, v, t->__size);
@@ -1468,7 +1467,7 @@ void *runtime_convT16(uint16_t v)
         return (void *)&staticuint64s[v];
     }
 
-    uint16_t *p = (uint16_t *)gc_alloc(2, NULL);
+    uint16_t *p = (uint16_t *)gc_alloc_noscan(2);
     if (p)
         *p = v;
     return p;
@@ -1484,7 +1483,7 @@ void *runtime_convT32(uint32_t v)
         return (void *)&staticuint64s[v];
     }
 
-    uint32_t *p = (uint32_t *)gc_alloc(4, NULL);
+    uint32_t *p = (uint32_t *)gc_alloc_noscan(4);
     if (p)
         *p = v;
     return p;
@@ -1500,7 +1499,7 @@ void *runtime_convT64(uint64_t v)
         return (void *)&staticuint64s[v];
     }
 
-    uint64_t *p = (uint64_t *)gc_alloc(8, NULL);
+    uint64_t *p = (uint64_t *)gc_alloc_noscan(8);
     if (p)
         *p = v;
     return p;
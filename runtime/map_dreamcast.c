@@ -357,10 +357,12 @@ MAP_INLINE void keyCopy(MapType *t, void *dst, void *src)
     if (MAPTYPE_FLAGS(t) & MAPTYPE_INDIRECT_KEY)
     {
         *(void **)dst = *(void **)src;
+        gc_write_barrier((void **)dst);
     }
     else
     {
         fast_copy(dst, src, MAPTYPE_KEYSIZE(t));
+        gc_write_barrier_range(dst, MAPTYPE_KEYSIZE(t));
     }
 }
 
@@ -374,10 +376,12 @@ MAP_INLINE void valueCopy(MapType *t, void *dst, void *src)
     if (MAPTYPE_FLAGS(t) & MAPTYPE_INDIRECT_VALUE)
     {
         *(void **)dst = *(void **)src;
+        gc_write_barrier((void **)dst);
     }
     else
     {
         fast_copy(dst, src, MAPTYPE_ELEMSIZE(t));
+        gc_write_barrier_range(dst, MAPTYPE_ELEMSIZE(t));
     }
 }
 
@@ -508,6 +512,7 @@ static void hashGrow(MapType *t, GoMap *h)
     if (h->buckets == NULL) {
         runtime_throw("hashGrow: bucket allocation returned NULL");
     }
+    gc_write_barrier(&h->buckets);
     
     h->oldbuckets = oldbuckets;
     h->nevacuate = 0;
@@ -656,6 +661,7 @@ static void evacuate(MapType *t, GoMap *h, uintptr_t oldbucket)
                     if (*overflow == NULL)
                     {
                         *overflow = allocBuckets(t, 1);
+                        gc_write_barrier(overflow);
                         h->noverflow++;
                     }
                     dest = *overflow;
@@ -772,6 +778,7 @@ GoMap *runtime_makemap(MapType *t, intptr_t hint, GoMap *h)
     {
         gc_inhibit_collection();
         h->buckets = allocBuckets(t, bucketCount(B));
+        gc_write_barrier(&h->buckets);
         gc_allow_collection();
     }
 
@@ -1079,6 +1086,7 @@ void *runtime_mapassign(MapType *t, GoMap *h, void *key)
             gc_allow_collection();
             runtime_throw("mapassign: bucket allocation returned NULL");
         }
+        gc_write_barrier(&h->buckets);
         h->B = 0;
     }
 
@@ -1158,6 +1166,7 @@ void *runtime_mapassign(MapType *t, GoMap *h, void *key)
 
         void *newb = allocBuckets(t, 1);
         *bucketOverflow(t, chainEnd) = newb;
+        gc_write_barrier(bucketOverflow(t, chainEnd));
         insertBucket = newb;
         insertSlot = 0;
         h->noverflow++;
@@ -255,6 +255,7 @@ void *runtime_mapassign_##suffix(MapType *t, GoMap *h, keytype key)
             gc_allow_collection();                                               \
             runtime_throw("mapassign_fast: bucket allocation returned NULL");    \
         }                                                                        \
+        gc_write_barrier(&h->buckets);                                           \
         h->B = 0;                                                                \
     }                                                                            \
                                                                                  \
@@ -319,6 +320,7 @@ void *runtime_mapassign_##suffix(MapType *t, GoMap *h, keytype key)
             chainEnd = *bucketOverflow(t, chainEnd);                             \
         void *newb = allocBuckets(t, 1);                                         \
         *bucketOverflow(t, chainEnd) = newb;                                     \
+        gc_write_barrier(bucketOverflow(t, chainEnd));                           \
         insertBucket = newb;                                                     \
         insertSlot = 0;                                                          \
         h->noverflow++;                                                          \
@@ -349,7 +351,8 @@ void *runtime_mapassign_##suffix(MapType *t, GoMap *h, keytype key)
 /* Key assignment macros */
 #define KEY_ASSIGN_UINT32(dst, key) (*(uint32_t *)(dst) = (key))
 #define KEY_ASSIGN_UINT64(dst, key) (*(uint64_t *)(dst) = (key))
-#define KEY_ASSIGN_STRING(dst, key) (*(GoString *)(dst) = (key))
+#define KEY_ASSIGN_STRING(dst, key) \
+    (*(GoString *)(dst) = (key), gc_write_barrier((void **)(dst)))
 
 #endif /* MAP_FAST_INTERNAL_H */
 
@@ -60,6 +60,10 @@ typedef struct _PanicRecord {
     bool goexit;                // Is this runtime.Goexit?
 } PanicRecord;
 
+/* arg_type is a static type descriptor */
+#define PANIC_RECORD_GC_PTRMAP \
+    (GC_PTRMAP_BIT(PanicRecord, link) | GC_PTRMAP_BIT(PanicRecord, arg_data))
+
 /**
  * Checkpoint record - recovery point for setjmp/longjmp
  */
@@ -69,6 +73,9 @@ typedef struct _Checkpoint {
     void *frame;                // Frame pointer when checkpoint created
 } Checkpoint;
 
+/* env and frame only hold registers and stack addresses of a live frame */
+#define CHECKPOINT_GC_PTRMAP GC_PTRMAP_BIT(Checkpoint, link)
+
 /* Public API - Called by gccgo-generated code */
 // NOTE: gccgo uses runtime_deferproc_gccgo (symbol: _runtime.deferproc)
 // and runtime_deferreturn_gccgo (symbol: _runtime.deferreturn) which are
@@ -209,6 +216,11 @@ _Static_assert(offsetof(GccgoDefer, makefunccanrecover) == 28,
 _Static_assert(offsetof(GccgoDefer, heap) == 29,
                "GccgoDefer.heap must be at offset 29");
 
+#define GCCGO_DEFER_GC_PTRMAP                                            \
+    (GC_PTRMAP_BIT(GccgoDefer, link) | GC_PTRMAP_BIT(GccgoDefer, frame) | \
+     GC_PTRMAP_BIT(GccgoDefer, panicStack) |                             \
+     GC_PTRMAP_BIT(GccgoDefer, _panic) | GC_PTRMAP_BIT(GccgoDefer, arg))
+
 /**
  * Register a stack-based defer (4 arguments from gccgo).
  * 
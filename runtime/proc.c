@@ -18,6 +18,19 @@ extern sh4_context_t sched_context;
 extern void allgs_add(G *gp);
 extern void allgs_remove(G *gp);
 
+/* A goroutine's G, TLS block and stack segment header, allocated
+ * together GOROUTINE_SLAB_SLOTS at a time and kept for reuse. The G comes
+ * first, so freegs is a list of slots. */
+typedef struct g_slot {
+    G g;
+    tls_block_t tls;
+    stack_segment_t seg;
+} g_slot_t;
+
+/* Slots not yet used in the newest slab */
+static g_slot_t *slab_next = NULL;
+static int slab_left = 0;
+
 /* Dead goroutine queue */
 static G *dead_queue_head = NULL;
 static G *dead_queue_tail = NULL;
@@ -71,6 +84,10 @@ static void free_g(G *gp)
     gp->checkpoint = NULL;
     gp->waiting = NULL;
 
+    /* alloc_g() keeps the stack scan cache buffer for the next G */
+    gp->gc_stack_nslots = 0;
+    gp->gc_stack_clean = false;
+
     /* Add to free list */
     gp->freeLink = freegs;
     freegs = gp;
@@ -89,35 +106,40 @@ void cleanup_dead_goroutines(void)
         if (!gp)
             break;
 
+        /* The stack goes back to its pool; the TLS block stays in gp's slot */
         allgs_remove(gp);
-
-        if (gp->tls) {
-            tls_free(gp->tls);
-            gp->tls = NULL;
-        }
         goroutine_stack_free(gp);
         free_g(gp);
         cleaned++;
     }
 }
 
-/* Allocate a G struct */
+/* Allocate a G with its TLS block and stack segment header */
 static G *alloc_g(void)
 {
-    G *gp;
+    g_slot_t *slot;
 
     if (freegs) {
-        gp = freegs;
-        freegs = gp->freeLink;
-        gp->freeLink = NULL;
+        slot = (g_slot_t *)freegs;
+        freegs = freegs->freeLink;
     } else {
-        gp = (G *)malloc(sizeof(G));
-        if (!gp)
-            runtime_throw("failed to allocate goroutine");
+        if (slab_left == 0) {
+            slab_next = (g_slot_t *)calloc(GOROUTINE_SLAB_SLOTS, sizeof(g_slot_t));
+            if (!slab_next)
+                runtime_throw("failed to allocate goroutine");
+            slab_left = GOROUTINE_SLAB_SLOTS;
+        }
+        slot = slab_next++;
+        slab_left--;
     }
 
-    memset(gp, 0, sizeof(G));
-    return gp;
+    uint16_t *stack_slots = slot->g.gc_stack_slots;
+
+    memset(slot, 0, sizeof(g_slot_t));
+    slot->g.tls = &slot->tls;
+    slot->g.stack = &slot->seg;
+    slot->g.gc_stack_slots = stack_slots;
+    return &slot->g;
 }
 
 /* Goroutine entry wrapper */
@@ -146,8 +168,8 @@ static void goroutine_entry_wrapper(void *unused)
     runtime_goexit_internal();
 }
 
-/* Create new goroutine */
-G *__go_go(void (*fn)(void *), void *arg)
+/* Create new goroutine on a stack of at least stack_size bytes */
+G *__go_go_stack(void (*fn)(void *), void *arg, size_t stack_size)
 {
     G *gp = alloc_g();
 
@@ -155,12 +177,15 @@ G *__go_go(void (*fn)(void *), void *arg)
     gp->startpc = (uintptr_t)fn;
     gp->param = arg;
 
-    if (!goroutine_stack_init(gp, GOROUTINE_STACK_SIZE)) {
+    /* The class is inherited from the creator; a deadline is not */
+    G *creator = getg();
+    gp->sched_class = creator ? creator->sched_class : SCHED_NORMAL;
+
+    if (!goroutine_stack_init(gp, stack_size)) {
         free_g(gp);
         runtime_throw("failed to allocate goroutine stack");
     }
 
-    gp->tls = tls_alloc();
     gp->tls->current_g = gp;
     gp->tls->stack_hi = gp->stack_hi;
     gp->tls->stack_lo = gp->stack_lo;
@@ -180,6 +205,33 @@ G *__go_go(void (*fn)(void *), void *arg)
     return gp;
 }
 
+/* Create new goroutine */
+G *__go_go(void (*fn)(void *), void *arg)
+{
+    size_t stack_size = GOROUTINE_STACK_INITIAL;
+
+    /* The hint is the creator's, so a yield before the go statement
+     * cannot hand it to another goroutine's spawn */
+    G *creator = getg();
+    if (creator && creator->spawn_stack_size) {
+        stack_size = creator->spawn_stack_size;
+        creator->spawn_stack_size = 0;
+    }
+    return __go_go_stack(fn, arg, stack_size);
+}
+
+/* runtime.SetSpawnStack - start the next goroutine the calling goroutine
+ * creates (its next go statement) on a stack of at least size bytes: 8KB,
+ * 32KB or 64KB, up to GOROUTINE_STACK_SIZE. Goroutines known to go deep
+ * then skip the moves growing to that size would take. */
+void runtime_SetSpawnStack(uintptr_t size) __asm__("_runtime.SetSpawnStack");
+void runtime_SetSpawnStack(uintptr_t size)
+{
+    G *gp = getg();
+    if (gp)
+        gp->spawn_stack_size = size < GOROUTINE_STACK_SIZE ? size : GOROUTINE_STACK_SIZE;
+}
+
 /* gccgo entry point */
 G *runtime_newproc(void (*fn)(void *), void *arg) __asm__("_runtime.newproc");
 G *runtime_newproc(void (*fn)(void *), void *arg)
@@ -205,6 +257,10 @@ void runtime_goexit_internal(void)
     if (gp->_defer)
         runtime_checkdefer(NULL);
 
+#if GOROUTINE_STACK_PAINT
+    goroutine_stack_profile(gp);
+#endif
+
     /* Clear state */
     gp->_defer = NULL;
     gp->_panic = NULL;
@@ -295,6 +351,7 @@ void proc_init(void)
     memset(main_g, 0, sizeof(G));
     main_g->goid = next_goid++;
     main_g->atomicstatus = Grunning;
+    main_g->sched_class = SCHED_NORMAL;
 
     kthread_t *cur_thd = thd_current;
     if (cur_thd && cur_thd->stack && cur_thd->stack_size > 0) {
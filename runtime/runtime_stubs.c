@@ -516,6 +516,8 @@ void _runtime_typedmemmove(void *typ, void *dst, void *src)
     if (td->__size > 0)
     {
         memmove(dst, src, td->__size);
+        if (td->__ptrdata != 0)
+            gc_write_barrier_range(dst, td->__ptrdata);
     }
 }
 
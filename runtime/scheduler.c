@@ -18,15 +18,21 @@ G *freegs = NULL;
 uint64_t next_goid = 1;
 uint32_t goroutine_count = 0;
 
-/* allgs array for GC iteration */
-#define ALLGS_ARRAY_MAX 512
-static G *allgs_array[ALLGS_ARRAY_MAX];
+/* allgs array for GC iteration, doubled when full */
+static G **allgs_array = NULL;
 static int allgs_count = 0;
+static int allgs_cap = 0;
 
 void allgs_add(G *gp)
 {
-    if (allgs_count >= ALLGS_ARRAY_MAX)
-        runtime_throw("too many goroutines");
+    if (allgs_count == allgs_cap) {
+        int cap = allgs_cap ? allgs_cap * 2 : ALLGS_INITIAL;
+        G **array = (G **)realloc(allgs_array, cap * sizeof(G *));
+        if (!array)
+            runtime_throw("too many goroutines");
+        allgs_array = array;
+        allgs_cap = cap;
+    }
     gp->allgs_index = allgs_count;
     allgs_array[allgs_count++] = gp;
 }
@@ -58,37 +64,133 @@ int allgs_get_count(void)
     return allgs_count;
 }
 
-/* Simple FIFO run queue */
-static G *runq_head = NULL;
-static G *runq_tail = NULL;
+/* Run queues, one per scheduling class, highest priority first. Normal
+ * and background queues are FIFO; the realtime queue is kept in
+ * deadline order (earliest deadline first), with goroutines that have no
+ * deadline after those that do. */
+typedef struct {
+    G *head;
+    G *tail;
+} runq_t;
+
+static runq_t runq[SCHED_CLASSES];
+static uint32_t sched_deadline_misses = 0;
+
+/* Realtime sort key: no deadline sorts last */
+static inline uint64_t deadline_key(G *gp)
+{
+    return gp->deadline_us ? gp->deadline_us : UINT64_MAX;
+}
 
 static void runq_put(G *gp)
 {
     if (!gp) return;
+    runq_t *q = &runq[gp->sched_class];
     gp->schedlink = NULL;
-    if (runq_tail) {
-        runq_tail->schedlink = gp;
+
+    /* Behind every goroutine due no later than gp */
+    if (gp->sched_class == SCHED_REALTIME && q->head &&
+        deadline_key(gp) < deadline_key(q->tail)) {
+        G **link = &q->head;
+        while (deadline_key(*link) <= deadline_key(gp))
+            link = &(*link)->schedlink;
+        gp->schedlink = *link;
+        *link = gp;
+        return;
+    }
+
+    if (q->tail) {
+        q->tail->schedlink = gp;
     } else {
-        runq_head = gp;
+        q->head = gp;
     }
-    runq_tail = gp;
+    q->tail = gp;
 }
 
-static G *runq_get(void)
+/* Highest priority class with a queued goroutine, SCHED_CLASSES if none */
+static int runq_top(void)
 {
-    G *gp = runq_head;
-    if (gp) {
-        runq_head = gp->schedlink;
-        if (!runq_head)
-            runq_tail = NULL;
-        gp->schedlink = NULL;
+    int c = 0;
+    while (c < SCHED_CLASSES && !runq[c].head)
+        c++;
+    return c;
+}
+
+static G *runq_pop(void)
+{
+    int c = runq_top();
+    if (c == SCHED_CLASSES)
+        return NULL;
+
+    runq_t *q = &runq[c];
+    G *gp = q->head;
+    q->head = gp->schedlink;
+    if (!q->head)
+        q->tail = NULL;
+    gp->schedlink = NULL;
+    return gp;
+}
+
+/* Whether a queued goroutine should run before gp */
+static bool runq_before(G *gp)
+{
+    int c = runq_top();
+    if (c != (int)gp->sched_class)
+        return c < (int)gp->sched_class;
+    return c == SCHED_REALTIME && deadline_key(runq[c].head) < deadline_key(gp);
+}
+
+/* runnext: the goroutine last woken by a channel operation, run ahead of
+ * the queue of its class. runnext_streak counts goroutines run that way
+ * in a row; past SCHED_RUNNEXT_MAX the queue gets a turn, so a pair of
+ * goroutines ping-ponging on a channel cannot starve the rest. */
+static G *runnext = NULL;
+static uint32_t runnext_streak = 0;
+static uint32_t sched_handoffs = 0;
+
+static G *runnext_get(void)
+{
+    G *gp = runnext;
+    if (!gp)
+        return NULL;
+
+    runnext = NULL;
+    bool demote = runq_before(gp);
+#if SCHED_RUNNEXT_MAX > 0
+    demote = demote || (runnext_streak >= SCHED_RUNNEXT_MAX && runq_top() < SCHED_CLASSES);
+#endif
+    if (demote) {
+        runq_put(gp);
+        return NULL;
     }
+    runnext_streak++;
+    return gp;
+}
+
+static G *runq_get(void)
+{
+    G *gp = runnext_get();
+    if (gp)
+        return gp;
+
+    gp = runq_pop();
+    if (gp)
+        runnext_streak = 0;
     return gp;
 }
 
 static inline bool runq_empty(void)
 {
-    return runq_head == NULL;
+    return runq_top() == SCHED_CLASSES && runnext == NULL;
+}
+
+/* Count a realtime goroutine that starts running after its deadline.
+ * A deadline covers one run: clear it, or every later run would miss. */
+static inline void deadline_check(G *gp)
+{
+    if (gp->deadline_us && timer_us_gettime64() > gp->deadline_us)
+        sched_deadline_misses++;
+    gp->deadline_us = 0;
 }
 
 /* Scheduler context */
@@ -96,36 +198,80 @@ sh4_context_t sched_context;
 static void *sched_kos_saved_stack = NULL;
 static size_t sched_kos_saved_stack_size = 0;
 
-/* Run a goroutine until it yields or exits */
+/* The goroutine on the CPU. Not always the one run_goroutine() switched
+ * to, since goroutines hand off to each other (sched_handoff). */
+static G *sched_running = NULL;
+
+/* When schedule_with_budget() must get control back (0: no budget) */
+static uint64_t sched_budget_deadline = 0;
+
+/* Run a goroutine until it, or one it handed off to, yields or exits.
+ * One that switched out only to have its stack grown is resumed straight
+ * away. */
 static void run_goroutine(G *gp)
 {
     kthread_t *cur_thd;
     int old_irq;
 
-    gp->atomicstatus = Grunning;
-    current_g = gp;
-    switch_to_goroutine(gp);
-
-    /* Save KOS thread stack, switch to goroutine stack */
-    cur_thd = thd_current;
-    old_irq = irq_disable();
-    sched_kos_saved_stack = cur_thd->stack;
-    sched_kos_saved_stack_size = cur_thd->stack_size;
-    cur_thd->stack = gp->stack_lo;
-
-    __go_swapcontext(&sched_context, &gp->context);
+    do {
+        deadline_check(gp);
+        gp->atomicstatus = Grunning;
+        current_g = gp;
+        sched_running = gp;
+        switch_to_goroutine(gp);
+
+        /* Save KOS thread stack, switch to goroutine stack */
+        cur_thd = thd_current;
+        old_irq = irq_disable();
+        sched_kos_saved_stack = cur_thd->stack;
+        sched_kos_saved_stack_size = cur_thd->stack_size;
+        cur_thd->stack = gp->stack_lo;
+
+        __go_swapcontext(&sched_context, &gp->context);
+
+        /* Returned from goroutine - restore KOS stack */
+        irq_disable();
+        cur_thd = thd_current;
+        cur_thd->stack = sched_kos_saved_stack;
+        cur_thd->stack_size = sched_kos_saved_stack_size;
+        irq_restore(old_irq);
+
+        __asm__ volatile("" ::: "memory");
+
+        gp = sched_running;
+        current_g = g0;
+        setg(g0);
+    } while (goroutine_stack_check(gp));
+}
 
-    /* Returned from goroutine - restore KOS stack */
+/* Switch from gp straight to runnext, if there is one, rather than to
+ * the scheduler and from there to it: one context switch instead of two.
+ * Returns false, having done nothing, if gp should switch to the
+ * scheduler: its stack needs growing, or a frame budget has run out. */
+static bool sched_handoff(G *gp)
+{
+    if (!goroutine_stack_handoff_ok(gp))
+        return false;
+    if (sched_budget_deadline && timer_us_gettime64() >= sched_budget_deadline)
+        return false;
+
+    G *next = runnext_get();
+    if (!next)
+        return false;
+
+    /* Resume next as run_goroutine() would: interrupts off, its TLS and
+     * its stack in the KOS thread */
+    deadline_check(next);
     irq_disable();
-    cur_thd = thd_current;
-    cur_thd->stack = sched_kos_saved_stack;
-    cur_thd->stack_size = sched_kos_saved_stack_size;
-    irq_restore(old_irq);
+    next->atomicstatus = Grunning;
+    sched_running = next;
+    switch_to_goroutine(next);
+    thd_current->stack = next->stack_lo;
+    sched_handoffs++;
 
+    __go_swapcontext(&gp->context, &next->context);
     __asm__ volatile("" ::: "memory");
-
-    current_g = g0;
-    setg(g0);
+    return true;
 }
 
 void schedule(void)
@@ -142,7 +288,10 @@ void schedule(void)
 
     /* Wait for blocked goroutines */
     while (goroutine_count > 1) {
-        gc_invalidate_incremental();
+        if (!gc_invalidate_incremental())
+            gc_prezero_incremental();
+        if (gc_heap.cycle_active)
+            gc_collect_step(GC_IDLE_STEP_US);
         thd_pass();
         if ((gp = runq_get()) != NULL) {
             run_goroutine(gp);
@@ -169,8 +318,10 @@ void gopark(bool (*unlockf)(void *), void *lock, WaitReason reason)
         return;
     }
 
-    __go_swapcontext(&gp->context, &sched_context);
-    __asm__ volatile("" ::: "memory");
+    if (!sched_handoff(gp)) {
+        __go_swapcontext(&gp->context, &sched_context);
+        __asm__ volatile("" ::: "memory");
+    }
 
     /* Re-enable interrupts after wakeup */
     int sr;
@@ -179,18 +330,42 @@ void gopark(bool (*unlockf)(void *), void *lock, WaitReason reason)
     __asm__ volatile("ldc %0, sr" : : "r"(sr));
 }
 
-/* Wake a goroutine */
-void goready(G *gp)
+static bool ready(G *gp)
 {
-    if (!gp) return;
+    if (!gp)
+        return false;
 
     Gstatus status = gp->atomicstatus;
     if (status == Gdead || status == Grunnable || status == Grunning)
-        return;
+        return false;
 
     gp->atomicstatus = Grunnable;
     gp->waitreason = waitReasonZero;
-    runq_put(gp);
+    gp->gc_stack_clean = false; /* The waker may have written its stack */
+    return true;
+}
+
+/* Wake a goroutine */
+void goready(G *gp)
+{
+    if (ready(gp))
+        runq_put(gp);
+}
+
+/* Wake the goroutine at the other end of a channel operation to run
+ * next, displacing any previous runnext to the back of the queue */
+void goready_next(G *gp)
+{
+    if (SCHED_RUNNEXT_MAX == 0) {
+        goready(gp);
+        return;
+    }
+    if (!ready(gp))
+        return;
+
+    if (runnext)
+        runq_put(runnext);
+    runnext = gp;
 }
 
 /* Prepare for yield - called by go_yield assembly.
@@ -219,8 +394,10 @@ void goroutine_yield_to_scheduler(void)
     gp->waitreason = waitReasonZero;
     runq_put(gp);
 
-    __go_swapcontext(&gp->context, &sched_context);
-    __asm__ volatile("" ::: "memory");
+    if (!sched_handoff(gp)) {
+        __go_swapcontext(&gp->context, &sched_context);
+        __asm__ volatile("" ::: "memory");
+    }
 }
 
 /* Initialize scheduler */
@@ -235,6 +412,7 @@ void scheduler_init(void)
     memset(g0, 0, sizeof(G));
     g0->goid = 0;
     g0->atomicstatus = Grunning;
+    g0->sched_class = SCHED_NORMAL;
     g0->allgs_index = -1;
 
     tls_init(g0);
@@ -244,12 +422,64 @@ void scheduler_init(void)
     current_g = g0;
 }
 
+/* runtime.SetSchedClass - put the calling goroutine, and goroutines it
+ * creates from now on, in class 0 (realtime), 1 (normal) or 2
+ * (background). Returns the previous class. */
+intptr_t runtime_SetSchedClass(intptr_t sched_class) __asm__("_runtime.SetSchedClass");
+intptr_t runtime_SetSchedClass(intptr_t sched_class)
+{
+    G *gp = getg();
+    if (!gp)
+        return SCHED_NORMAL;
+
+    intptr_t prev = gp->sched_class;
+    if (sched_class >= SCHED_REALTIME && sched_class < SCHED_CLASSES)
+        gp->sched_class = (uint8_t)sched_class;
+    return prev;
+}
+
+/* runtime.SetDeadline - realtime goroutines run earliest deadline first.
+ * Sets the calling goroutine's deadline us microseconds from now, or
+ * clears it if us <= 0. Setting one makes the goroutine realtime. The
+ * deadline is for its next run and is cleared once that starts. */
+void runtime_SetDeadline(int64_t us) __asm__("_runtime.SetDeadline");
+void runtime_SetDeadline(int64_t us)
+{
+    G *gp = getg();
+    if (!gp)
+        return;
+
+    if (us <= 0) {
+        gp->deadline_us = 0;
+        return;
+    }
+    gp->deadline_us = timer_us_gettime64() + (uint64_t)us;
+    gp->sched_class = SCHED_REALTIME;
+}
+
+/* runtime.schedDeadlineMisses - realtime goroutines run after their deadline */
+uint32_t runtime_schedDeadlineMisses(void) __asm__("_runtime.schedDeadlineMisses");
+uint32_t runtime_schedDeadlineMisses(void)
+{
+    return sched_deadline_misses;
+}
+
+/* runtime.schedHandoffs - switches made goroutine to goroutine */
+uint32_t runtime_schedHandoffs(void) __asm__("_runtime.schedHandoffs");
+uint32_t runtime_schedHandoffs(void)
+{
+    return sched_handoffs;
+}
+
 void scheduler_start(void)
 {
     if (!runq_empty())
         schedule();
 }
 
+/* Run goroutines for up to budget_us, highest class first: background
+ * goroutines run only once no realtime or normal one is runnable, so
+ * they get whatever budget those leave. */
 int schedule_with_budget(uint64_t budget_us)
 {
     G *gp;
@@ -259,6 +489,7 @@ int schedule_with_budget(uint64_t budget_us)
     setg(g0);
     cleanup_dead_goroutines();
 
+    sched_budget_deadline = deadline;
     while ((gp = runq_get()) != NULL) {
         ran++;
         run_goroutine(gp);
@@ -267,6 +498,18 @@ int schedule_with_budget(uint64_t budget_us)
         if (timer_us_gettime64() >= deadline)
             break;
     }
+    sched_budget_deadline = 0;
+
+    /* Leftover budget advances an incremental collection, or else clears
+     * free memory so later allocations can skip zeroing */
+    if (gc_heap.cycle_active) {
+        uint64_t now = timer_us_gettime64();
+        if (now < deadline)
+            gc_collect_step((uint32_t)(deadline - now));
+    } else {
+        while (timer_us_gettime64() < deadline && gc_prezero_incremental())
+            ;
+    }
 
     return ran;
 }
@@ -341,11 +341,11 @@ SelectGoResult selectgo(scase *cas0, uint16_t *order0, int nsends, int nrecvs, b
                 // Direct send to receiver
                 if (cas->elem != NULL && c->elemsize > 0)
                 {
-                    fast_copy(sg->elem, cas->elem, c->elemsize);
+                    chan_copy(c, sg->elem, cas->elem);
                 }
                 sg->success = true;
                 selunlock(cas0, lockorder, ncases);
-                goready(sg->g);
+                goready_next(sg->g);
                 result.selected = selected;
                 result.recvOK = false; // Not a receive
                 return result;
@@ -355,7 +355,7 @@ SelectGoResult selectgo(scase *cas0, uint16_t *order0, int nsends, int nrecvs, b
             void *dst = chanbuf(c, c->sendx);
             if (cas->elem != NULL && c->elemsize > 0)
             {
-                fast_copy(dst, cas->elem, c->elemsize);
+                chan_copy(c, dst, cas->elem);
             }
             c->sendx = (c->sendx + 1) % c->dataqsiz;
             c->qcount++;
@@ -376,7 +376,7 @@ SelectGoResult selectgo(scase *cas0, uint16_t *order0, int nsends, int nrecvs, b
                     // Unbuffered receive from sender
                     if (cas->elem != NULL && c->elemsize > 0)
                     {
-                        fast_copy(cas->elem, sg->elem, c->elemsize);
+                        chan_copy(c, cas->elem, sg->elem);
                     }
                 }
                 else
@@ -388,16 +388,16 @@ SelectGoResult selectgo(scase *cas0, uint16_t *order0, int nsends, int nrecvs, b
                     void *src = chanbuf(c, c->recvx);
                     if (cas->elem != NULL && c->elemsize > 0)
                     {
-                        fast_copy(cas->elem, src, c->elemsize);
+                        chan_copy(c, cas->elem, src);
                     }
                     // Copy sender's data to the freed slot
-                    fast_copy(src, sg->elem, c->elemsize);
+                    chan_copy(c, src, sg->elem);
                     c->recvx = (c->recvx + 1) % c->dataqsiz;
                     c->sendx = c->recvx; // CRITICAL: keep sendx in sync
                 }
                 sg->success = true;
                 selunlock(cas0, lockorder, ncases);
-                goready(sg->g);
+                goready_next(sg->g);
                 result.selected = selected;
                 result.recvOK = true; // Received actual data from sender
                 return result;
@@ -409,7 +409,7 @@ SelectGoResult selectgo(scase *cas0, uint16_t *order0, int nsends, int nrecvs, b
                 void *src = chanbuf(c, c->recvx);
                 if (cas->elem != NULL && c->elemsize > 0)
                 {
-                    fast_copy(cas->elem, src, c->elemsize);
+                    chan_copy(c, cas->elem, src);
                 }
                 memset(src, 0, c->elemsize);
                 c->recvx = (c->recvx + 1) % c->dataqsiz;
@@ -1,7 +1,38 @@
-/* libgodc/runtime/stack.c - Stack management for goroutines */
+/* libgodc/runtime/stack.c - Stack management for goroutines
+ *
+ * Goroutines start on a GOROUTINE_STACK_INITIAL stack. There are no
+ * split-stack prologues (the runtime is built with -fno-split-stack), so
+ * growth happens at safe points instead: every heap allocation compares
+ * the stack pointer with tls->stack_guard, which sits halfway up a
+ * growable stack, and the scheduler compares each goroutine's saved stack
+ * pointer with it when the goroutine switches out. A goroutine below its
+ * guard is moved, while it is switched out, to a stack of the next size
+ * class (8KB, 32KB, 64KB by default).
+ *
+ * Moving copies the used part of the stack to the top of the new segment
+ * and then fixes pointers into the old one conservatively, the same way
+ * the collector scans stacks: any word in the copied frames, the saved
+ * callee-saved registers, the G, its sudogs and its heap defer, panic and
+ * checkpoint records that holds an old stack address is relocated. Go
+ * code never stores stack addresses in the heap, so these are all.
+ *
+ * A full-size stack keeps its guard STACK_GUARD_SIZE bytes above the
+ * bottom; reaching it throws "goroutine stack overflow". Code that goes
+ * deep without allocating or switching passes no guard check, but it
+ * overwrites the canary words at the bottom of the segment before it runs
+ * off it; the next switch out finds them changed and throws instead of
+ * carrying on with corrupted memory below the stack.
+ *
+ * With GOROUTINE_STACK_PAINT, new segments are filled with a known word
+ * and the deepest use is found, when a goroutine exits or is moved, by
+ * looking for the lowest word that was overwritten. Peaks are kept per
+ * entry function (G.startpc: for a go statement, the compiler's thunk
+ * for that statement) and printed by runtime.PrintStackProfile.
+ */
 
 #include "goroutine.h"
 #include "gc_semispace.h"
+#include "panic_dreamcast.h"
 #include "runtime.h"
 #include <string.h>
 #include <kos.h>
@@ -9,8 +40,9 @@
 
 #define STACK_SIZE_CLASSES 3
 
-/* Stack pools */
-static stack_segment_t *stack_pools[STACK_SIZE_CLASSES] = {NULL, NULL, NULL};
+/* Stack pools: free stacks of each size class, linked through their
+ * first word. Segment headers live with the G (proc.c), not here. */
+static void *stack_pools[STACK_SIZE_CLASSES] = {NULL, NULL, NULL};
 static int pool_counts[STACK_SIZE_CLASSES] = {0, 0, 0};
 
 static int get_size_class(size_t size)
@@ -35,123 +67,361 @@ static size_t round_to_size_class(size_t size)
     return (size + 4095) & ~4095;
 }
 
-__attribute__((no_split_stack))
-stack_segment_t *stack_alloc(size_t size)
+/* A stack of size bytes, which must be a class size */
+void *stack_alloc(size_t size)
 {
-    size = round_to_size_class(size);
+    int class_idx = get_size_class(size);
 
-    stack_segment_t *seg = stack_pool_get(size);
-    if (seg)
-        return seg;
+    if (class_idx >= 0 && stack_pools[class_idx]) {
+        void *base = stack_pools[class_idx];
+        stack_pools[class_idx] = *(void **)base;
+        pool_counts[class_idx]--;
+        return base;
+    }
 
     void *base = memalign(8, size);
     if (!base)
         runtime_throw("stack_alloc: out of memory");
+    return base;
+}
+
+__attribute__((no_split_stack))
+void stack_free(void *base, size_t size)
+{
+    if (!base)
+        return;
 
-    seg = (stack_segment_t *)malloc(sizeof(stack_segment_t));
-    if (!seg) {
-        free(base);
-        runtime_throw("stack_alloc: out of memory for header");
+    int class_idx = get_size_class(size);
+    if (class_idx >= 0 && pool_counts[class_idx] < STACK_POOL_MAX_SEGMENTS / STACK_SIZE_CLASSES) {
+        *(void **)base = stack_pools[class_idx];
+        stack_pools[class_idx] = base;
+        pool_counts[class_idx]++;
+        return;
     }
 
+    free(base);
+}
+
+/* Give seg a new stack of at least size bytes */
+static void stack_segment_init(stack_segment_t *seg, size_t size)
+{
+    size = round_to_size_class(size);
+
     seg->prev = NULL;
-    seg->base = base;
+    seg->pool_next = NULL;
+    seg->base = stack_alloc(size);
     seg->size = size;
     seg->sp_on_entry = NULL;
-    seg->guard = (void *)((uintptr_t)base + STACK_GUARD_SIZE);
+    seg->guard = (void *)((uintptr_t)seg->base + STACK_GUARD_SIZE);
     seg->pooled = false;
+}
+
+/* Bottom words of every segment in use (free ones link through word 0) */
+#define STACK_CANARY_WORDS 8
+#define STACK_CANARY_WORD 0xc0a1c0a1u
+
+static void stack_canary_set(stack_segment_t *seg)
+{
+    uint32_t *w = (uint32_t *)seg->base;
 
-    return seg;
+    for (int i = 0; i < STACK_CANARY_WORDS; i++)
+        w[i] = STACK_CANARY_WORD;
 }
 
-__attribute__((no_split_stack))
-void stack_free(stack_segment_t *seg)
+static bool stack_canary_ok(const stack_segment_t *seg)
 {
-    if (!seg)
-        return;
+    const uint32_t *w = (const uint32_t *)seg->base;
 
-    if (!seg->base || seg->size == 0) {
-        free(seg);
-        return;
+    for (int i = 0; i < STACK_CANARY_WORDS; i++) {
+        if (w[i] != STACK_CANARY_WORD)
+            return false;
     }
+    return true;
+}
 
-    int class_idx = get_size_class(seg->size);
-    if (class_idx >= 0 && pool_counts[class_idx] < STACK_POOL_MAX_SEGMENTS / STACK_SIZE_CLASSES) {
-        stack_pool_put(seg);
+/* Size to move a goroutine to from a size-byte stack: the next class up,
+ * then doubling past the largest class, at most GOROUTINE_STACK_SIZE */
+static size_t stack_next_size(size_t size)
+{
+    size_t next = size < STACK_SIZE_LARGE ? round_to_size_class(size + 1) : size * 2;
+    return next < GOROUTINE_STACK_SIZE ? next : GOROUTINE_STACK_SIZE;
+}
+
+static uint32_t stack_growths;
+
+#if GOROUTINE_STACK_PAINT
+#define STACK_PAINT_WORD 0x57ac57acu
+
+typedef struct {
+    uintptr_t startpc;
+    uint32_t goroutines;
+    uint32_t peak;        /* Deepest use, bytes */
+    uint32_t size;        /* Largest segment those goroutines had */
+} stack_profile_t;
+
+static stack_profile_t stack_profile[STACK_PROFILE_ENTRIES];
+static uint32_t stack_profile_count;
+static uint32_t stack_profile_dropped;
+
+static void stack_paint(void *base, size_t size)
+{
+    uint32_t *w = (uint32_t *)base;
+
+    for (size_t i = 0; i < size / sizeof(uint32_t); i++)
+        w[i] = STACK_PAINT_WORD;
+}
+
+/* Bytes of seg ever used: from the lowest overwritten word above the
+ * canary to the top */
+static uint32_t stack_high_water(stack_segment_t *seg)
+{
+    uint32_t *w = (uint32_t *)seg->base;
+    size_t n = seg->size / sizeof(uint32_t);
+    size_t i = STACK_CANARY_WORDS;
+
+    while (i < n && w[i] == STACK_PAINT_WORD)
+        i++;
+    return (uint32_t)((n - i) * sizeof(uint32_t));
+}
+
+/* Called as gp exits, on its own stack */
+void goroutine_stack_profile(G *gp)
+{
+    if (!gp->stack || !gp->startpc)
         return;
+
+    uint32_t peak = stack_high_water(gp->stack);
+    if (gp->stack_peak > peak)
+        peak = gp->stack_peak;
+
+    stack_profile_t *e = NULL;
+    for (uint32_t i = 0; i < stack_profile_count; i++) {
+        if (stack_profile[i].startpc == gp->startpc) {
+            e = &stack_profile[i];
+            break;
+        }
+    }
+    if (!e) {
+        if (stack_profile_count == STACK_PROFILE_ENTRIES) {
+            stack_profile_dropped++;
+            return;
+        }
+        e = &stack_profile[stack_profile_count++];
+        e->startpc = gp->startpc;
     }
 
-    free(seg->base);
-    free(seg);
+    e->goroutines++;
+    if (peak > e->peak)
+        e->peak = peak;
+    if (gp->stack->size > e->size)
+        e->size = (uint32_t)gp->stack->size;
 }
+#endif
 
-stack_segment_t *stack_pool_get(size_t min_size)
+/* Point gp at seg, with the guard halfway up unless seg is full size */
+static void goroutine_stack_set(G *gp, stack_segment_t *seg)
 {
-    int class_idx = get_size_class(min_size);
-    if (class_idx < 0)
-        return NULL;
+    gp->stack = seg;
+    gp->stack_lo = seg->base;
+    gp->stack_hi = (void *)((uintptr_t)seg->base + seg->size);
+    if (seg->size < GOROUTINE_STACK_SIZE)
+        gp->stack_guard = (void *)((uintptr_t)seg->base + seg->size / 2);
+    else
+        gp->stack_guard = seg->guard;
+}
 
-    if (stack_pools[class_idx]) {
-        stack_segment_t *seg = stack_pools[class_idx];
-        stack_pools[class_idx] = seg->pool_next;
-        pool_counts[class_idx]--;
-        seg->pool_next = NULL;
-        seg->pooled = false;
-        return seg;
+/* gp->stack is the segment header from gp's slot (proc.c) */
+bool goroutine_stack_init(G *gp, size_t stack_size)
+{
+    if (!gp || !gp->stack)
+        return false;
+
+    stack_segment_init(gp->stack, stack_size);
+    goroutine_stack_set(gp, gp->stack);
+#if GOROUTINE_STACK_PAINT
+    stack_paint(gp->stack->base, gp->stack->size);
+    gp->stack_peak = 0;
+#endif
+    stack_canary_set(gp->stack);
+    return true;
+}
+
+/* Add delta to each of the n words at p that holds an address in
+ * [lo, lo + size) */
+static void stack_relocate(void *p, size_t n, uintptr_t lo, size_t size,
+                           intptr_t delta)
+{
+    uintptr_t *w = (uintptr_t *)p;
+
+    for (size_t i = 0; i < n; i++) {
+        if (w[i] - lo < size)
+            w[i] += delta;
     }
+}
 
-    for (int i = class_idx + 1; i < STACK_SIZE_CLASSES; i++) {
-        if (stack_pools[i]) {
-            stack_segment_t *seg = stack_pools[i];
-            stack_pools[i] = seg->pool_next;
-            pool_counts[i]--;
-            seg->pool_next = NULL;
-            seg->pooled = false;
-            return seg;
-        }
+#define WORDS(x) (sizeof(x) / sizeof(uintptr_t))
+
+/* Move a switched-out goroutine to a stack of the next size */
+static void goroutine_stack_grow(G *gp)
+{
+    stack_segment_t *seg = gp->stack;
+    uintptr_t lo = (uintptr_t)seg->base;
+    size_t size = seg->size;
+    uintptr_t sp = gp->context.sp;
+
+    if (sp - lo >= size)
+        runtime_throw("goroutine stack grow: sp outside its stack");
+
+#if GOROUTINE_STACK_PAINT
+    uint32_t peak = stack_high_water(seg);
+    if (peak > gp->stack_peak)
+        gp->stack_peak = peak;
+#endif
+
+    stack_segment_init(seg, stack_next_size(size));
+    uintptr_t new_lo = (uintptr_t)seg->base;
+    intptr_t delta = (intptr_t)(new_lo + seg->size) - (intptr_t)(lo + size);
+
+    Gstatus status = gp->atomicstatus;
+    gp->atomicstatus = Gcopystack;
+
+#if GOROUTINE_STACK_PAINT
+    stack_paint(seg->base, seg->size);
+#endif
+    stack_canary_set(seg);
+
+    /* The frames, then everything else that can point into them */
+    size_t used = lo + size - sp;
+    memcpy((void *)(sp + delta), (void *)sp, used);
+    stack_relocate((void *)(sp + delta), used / sizeof(uintptr_t), lo, size, delta);
+
+    stack_relocate(&gp->context.r8, 8, lo, size, delta); /* r8-r14, sp */
+    stack_relocate(&gp->param, 1, lo, size, delta);
+
+    for (sudog *sg = gp->waiting; sg; sg = sg->waitlink)
+        stack_relocate(&sg->elem, 1, lo, size, delta);
+
+    /* Records on the new stack were fixed with their frames */
+    stack_relocate(&gp->_defer, 1, lo, size, delta);
+    for (GccgoDefer *d = gp->_defer; d; d = d->link) {
+        if ((uintptr_t)d - new_lo >= seg->size)
+            stack_relocate(d, WORDS(*d), lo, size, delta);
+    }
+
+    stack_relocate(&gp->_panic, 1, lo, size, delta);
+    for (PanicRecord *p = gp->_panic; p; p = p->link) {
+        if ((uintptr_t)p - new_lo >= seg->size)
+            stack_relocate(p, WORDS(*p), lo, size, delta);
+    }
+
+    stack_relocate(&gp->checkpoint, 1, lo, size, delta);
+    for (Checkpoint *cp = gp->checkpoint; cp; cp = cp->link) {
+        if ((uintptr_t)cp - new_lo >= seg->size)
+            stack_relocate(cp, WORDS(*cp), lo, size, delta);
     }
 
-    return NULL;
+    goroutine_stack_set(gp, seg);
+    gp->gc_stack_clean = false;
+    gp->atomicstatus = status;
+
+    stack_free((void *)lo, size);
+    stack_growths++;
 }
 
-void stack_pool_put(stack_segment_t *seg)
+/* Called below the stack guard: switch out so the scheduler can move the
+ * stack, and carry on on the new one */
+void goroutine_morestack(void)
 {
-    if (!seg)
+    G *gp = getg();
+    if (!gp || gp == g0 || !gp->stack)
         return;
 
-    int class_idx = get_size_class(seg->size);
-    if (class_idx < 0) {
-        stack_free(seg);
-        return;
-    }
+    if (gp->stack->size >= GOROUTINE_STACK_SIZE)
+        runtime_throw("goroutine stack overflow (raise GOROUTINE_STACK_SIZE)");
 
-    if (pool_counts[class_idx] >= STACK_POOL_MAX_SEGMENTS / STACK_SIZE_CLASSES) {
-        free(seg->base);
-        free(seg);
-        return;
-    }
+    /* The scheduler resumes us with interrupts off; put back what the
+     * allocating caller had */
+    int sr;
+    __asm__ volatile("stc sr, %0" : "=r"(sr));
 
-    seg->prev = NULL;
-    seg->sp_on_entry = NULL;
-    seg->pooled = true;
-    seg->pool_next = stack_pools[class_idx];
-    stack_pools[class_idx] = seg;
-    pool_counts[class_idx]++;
+    gp->gflags2 |= G_FLAG2_MORESTACK;
+    __go_swapcontext(&gp->context, &sched_context);
+    __asm__ volatile("" ::: "memory");
+
+    __asm__ volatile("ldc %0, sr" : : "r"(sr));
 }
 
-bool goroutine_stack_init(G *gp, size_t stack_size)
+/* Run on the scheduler stack each time gp switches out. Throws if gp ran
+ * off its stack since the last check, and grows the stack if gp asked for
+ * it (then gp must be resumed right away: returns true) or was switched
+ * out below its guard. */
+bool goroutine_stack_check(G *gp)
 {
-    if (!gp)
+    if (!gp->stack || !gp->stack->base)
         return false;
 
-    stack_segment_t *seg = stack_alloc(stack_size);
+    if (!stack_canary_ok(gp->stack))
+        runtime_throw("goroutine stack overflow (canary overwritten)");
 
-    gp->stack = seg;
-    gp->stack_lo = seg->base;
-    gp->stack_hi = (void *)((uintptr_t)seg->base + seg->size);
-    gp->stack_guard = seg->guard;
+    if (gp->atomicstatus == Gdead)
+        return false;
 
-    return true;
+    bool resume = gp->gflags2 & G_FLAG2_MORESTACK;
+    gp->gflags2 &= ~G_FLAG2_MORESTACK;
+
+    if ((resume || gp->context.sp < (uintptr_t)gp->stack_guard) &&
+        gp->stack->size < GOROUTINE_STACK_SIZE)
+        goroutine_stack_grow(gp);
+    return resume;
+}
+
+/* Run on gp's own stack before it switches straight to another goroutine
+ * (sched_handoff), which skips goroutine_stack_check(). Throws as that
+ * does on an overwritten canary; false if gp is below the guard of a
+ * growable stack and must switch out to the scheduler to have it grown. */
+bool goroutine_stack_handoff_ok(G *gp)
+{
+    if (!gp->stack || !gp->stack->base)
+        return true;
+
+    if (!stack_canary_ok(gp->stack))
+        runtime_throw("goroutine stack overflow (canary overwritten)");
+
+    return gp->stack->size >= GOROUTINE_STACK_SIZE || !goroutine_stack_low();
+}
+
+/* runtime.stackGrowths - goroutine stacks moved to a larger segment */
+uint32_t runtime_stackGrowths(void) __asm__("_runtime.stackGrowths");
+uint32_t runtime_stackGrowths(void)
+{
+    return stack_growths;
+}
+
+/* runtime.PrintStackProfile - the deepest stack use of exited goroutines,
+ * per entry function. Symbolize the pcs with sh-elf-addr2line. */
+void runtime_PrintStackProfile(void) __asm__("_runtime.PrintStackProfile");
+void runtime_PrintStackProfile(void)
+{
+#if GOROUTINE_STACK_PAINT
+    dbglog(DBG_INFO, "stack profile: %lu entry functions, %lu dropped\n",
+           (unsigned long)stack_profile_count, (unsigned long)stack_profile_dropped);
+    for (uint32_t i = 0; i < stack_profile_count; i++) {
+        stack_profile_t *e = &stack_profile[i];
+        dbglog(DBG_INFO, "  pc %08lx: %lu goroutines, peak %lu of %lu bytes\n",
+               (unsigned long)e->startpc, (unsigned long)e->goroutines,
+               (unsigned long)e->peak, (unsigned long)e->size);
+    }
+#else
+    dbglog(DBG_INFO, "stack profile: build with GOROUTINE_STACK_PAINT=1\n");
+#endif
+}
+
+/* Size of the running goroutine's stack segment, for tests */
+uintptr_t runtime_stackSize(void) __asm__("_runtime.stackSize");
+uintptr_t runtime_stackSize(void)
+{
+    G *gp = getg();
+    return gp && gp->stack ? gp->stack->size : 0;
 }
 
 void goroutine_stack_free(G *gp)
@@ -159,11 +429,12 @@ void goroutine_stack_free(G *gp)
     if (!gp)
         return;
 
+    /* The header stays with gp's slot */
     stack_segment_t *seg = gp->stack;
-    while (seg) {
-        stack_segment_t *prev = seg->prev;
-        stack_free(seg);
-        seg = prev;
+    if (seg) {
+        stack_free(seg->base, seg->size);
+        seg->base = NULL;
+        seg->size = 0;
     }
 
     gp->stack = NULL;
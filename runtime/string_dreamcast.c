@@ -276,7 +276,7 @@ static GoString gostringsize(intptr_t len)
 
     // Allocate memory for string + null terminator
     // Strings don't contain pointers
-    s.str = (uint8_t *)gc_alloc(len + 1, NULL);
+    s.str = (uint8_t *)gc_alloc_noscan(len + 1);
     if (s.str == NULL)
     {
         s.len = 0;
@@ -535,7 +535,7 @@ static GoSlice stringtoslicebyte_internal(void *buf, const uint8_t *str, intptr_
     else
     {
         // Allocate new byte array (strings are immutable, slices are not)
-        b.__values = gc_alloc(len, NULL);
+        b.__values = gc_alloc_noscan(len);
         if (b.__values == NULL)
         {
             b.__count = 0;
@@ -608,7 +608,7 @@ GoString runtime_intstring(void *buf, int64_t v)
     else
     {
         // Heap allocate
-        dst = (uint8_t *)gc_alloc(len + 1, NULL);
+        dst = (uint8_t *)gc_alloc_noscan(len + 1);
         if (dst == NULL)
         {
             return runtime_emptystring;
@@ -678,7 +678,7 @@ GoString runtime_formatint64(int64_t value, int base)
     int len = 64 - pos;
 
     // Create string
-    s.str = (uint8_t *)gc_alloc(len + 1, NULL);
+    s.str = (uint8_t *)gc_alloc_noscan(len + 1);
     if (s.str == NULL)
     {
         s.len = 0;
@@ -727,7 +727,7 @@ GoString runtime_formatuint64(uint64_t value, int base)
     int len = 64 - pos;
 
     // Create string
-    s.str = (uint8_t *)gc_alloc(len + 1, NULL);
+    s.str = (uint8_t *)gc_alloc_noscan(len + 1);
     if (s.str == NULL)
     {
         s.len = 0;
@@ -867,7 +867,7 @@ void *runtime_rawstring(size_t size)
 {
     if (size == 0)
         return NULL;
-    return gc_alloc(size, NULL); // NULL type = NOSCAN
+    return gc_alloc_noscan(size);
 }
 
 // Allocate raw byte slice backing array (NOSCAN)
@@ -875,7 +875,7 @@ void *runtime_rawbyteslice(size_t size)
 {
     if (size == 0)
         return NULL;
-    return gc_alloc(size, NULL); // NULL type = NOSCAN
+    return gc_alloc_noscan(size);
 }
 
 // Allocate raw rune slice backing array (NOSCAN - rune is int32, no pointers)
@@ -883,7 +883,7 @@ void *runtime_rawruneslice(size_t count)
 {
     if (count == 0)
         return NULL;
-    return gc_alloc(count * sizeof(int32_t), NULL); // NULL type = NOSCAN
+    return gc_alloc_noscan(count * sizeof(int32_t));
 }
 
 // copy(dst, src) builtin - returns number of elements copied
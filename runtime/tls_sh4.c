@@ -36,6 +36,7 @@ void switch_to_goroutine(G *gp)
 
     current_g = gp;
     current_tls = tls;
+    gp->gc_stack_clean = false; /* Its stack is about to change */
     __asm__ volatile("" ::: "memory");
 }
 
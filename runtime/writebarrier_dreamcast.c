@@ -1,21 +1,62 @@
 #include "runtime.h"
+#include "gc_semispace.h"
 
 #include <stdint.h>
 
 /* runtime_writeBarrier - Write barrier flag variable
  *
- * gccgo expects this to be a struct/variable that it can read to check
- * if write barriers are enabled. For bare-metal Dreamcast we keep it disabled (0).
+ * gccgo reads this before every heap pointer store and only calls
+ * gcWriteBarrier when it is non-zero. The generational GC needs the
+ * barrier to find old-to-young pointers, so it is always enabled.
  */
 struct {
     uint32_t enabled;
     uint32_t pad1, pad2, pad3;
-} runtime_writeBarrier __asm__("_runtime.writeBarrier") = {0, 0, 0, 0};
+} runtime_writeBarrier __asm__("_runtime.writeBarrier") = {1, 0, 0, 0};
+
+gc_remset_t gc_remset;
+
+/* gc_remember - Record a remembered set entry
+ *
+ * Never collects: on overflow the next minor GC falls back to scanning
+ * the whole semispace instead.
+ */
+void gc_remember(uintptr_t entry)
+{
+    /* Repeated stores to the same slot are common (loops, accumulators) */
+    if (gc_remset.count > 0 && gc_remset.entries[gc_remset.count - 1] == entry)
+        return;
+
+    if (gc_remset.count >= GC_REMSET_ENTRIES)
+    {
+        gc_remset.overflow = true;
+        return;
+    }
+
+    gc_remset.entries[gc_remset.count++] = entry;
+}
+
+/* gc_remember_range - Remember every word in [dst, dst+size) that now
+ * holds a nursery pointer. Used after bulk copies done in C.
+ */
+void gc_remember_range(void *dst, size_t size)
+{
+    uintptr_t *p = (uintptr_t *)(((uintptr_t)dst + sizeof(void *) - 1) &
+                                 ~(uintptr_t)(sizeof(void *) - 1));
+    uintptr_t *end = (uintptr_t *)((uintptr_t)dst + size);
+
+    for (; p < end; p++)
+    {
+        if (gc_in_nursery((void *)*p))
+            gc_remember((uintptr_t)p);
+    }
+}
 
 /* runtime_gcWriteBarrier - GC write barrier function
  *
  * This is called when writing a pointer from one object to another.
- * For bare-metal Dreamcast, this is a no-op that just performs the write.
+ * Performs the store, then records the slot if it is an old-to-young
+ * pointer.
  *
  * gccgo signature: func gcWriteBarrier(dst *uintptr, src uintptr)
  * The src parameter is a uintptr, not a pointer, per gccgo convention.
@@ -23,9 +64,9 @@ struct {
 void runtime_gcWriteBarrier(void *dst, uintptr_t src) __asm__("_runtime.gcWriteBarrier");
 void runtime_gcWriteBarrier(void *dst, uintptr_t src)
 {
-    /* For bare-metal Dreamcast, just perform the write directly */
     if (dst) {
         *(uintptr_t *)dst = src;
+        gc_write_barrier((void **)dst);
     }
 }
 
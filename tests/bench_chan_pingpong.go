@@ -0,0 +1,78 @@
+//go:build ignore
+
+// bench_chan_pingpong.go - Channel ping-pong between two goroutines
+//
+// Each round is a send that wakes the other goroutine and a receive
+// that parks this one. With direct handoff the parking goroutine
+// switches straight to the one it woke; without it, every park goes
+// through the scheduler. Build and run once each way, then compare:
+//
+//	make -C .. clean all                       # direct handoff (default)
+//	make -C .. clean all SCHED_RUNNEXT_MAX=0   # through the scheduler
+package main
+
+import _ "unsafe"
+
+//go:linkname nanotime runtime.nanotime
+func nanotime() int64
+
+//go:linkname forceGC runtime.GC
+func forceGC()
+
+//go:linkname schedHandoffs runtime.schedHandoffs
+func schedHandoffs() uint32
+
+// SH-4 at 200MHz: 5ns per cycle
+const nsPerCycle = 5
+
+var sink int
+
+func pingPong(rounds int, ping, pong chan int) (int64, uint32) {
+	done := make(chan bool)
+	go func() {
+		for v := range ping {
+			pong <- v + 1
+		}
+		done <- true
+	}()
+
+	handoffs := schedHandoffs()
+	start := nanotime()
+	for i := 0; i < rounds; i++ {
+		ping <- i
+		sink += <-pong
+	}
+	elapsed := nanotime() - start
+	handoffs = schedHandoffs() - handoffs
+
+	close(ping)
+	<-done
+	return elapsed, handoffs
+}
+
+func report(name string, rounds int, elapsed int64, handoffs uint32) {
+	perRound := elapsed / int64(rounds)
+	println(" ", name)
+	println("    per round:  ", perRound, "ns,", perRound/nsPerCycle, "cycles")
+	println("    handoffs:   ", handoffs/uint32(rounds), "per round")
+}
+
+func main() {
+	println("bench_chan_pingpong")
+	println("")
+
+	const rounds = 2000
+
+	pingPong(100, make(chan int), make(chan int)) // Warm up Gs and sudogs
+	forceGC()
+
+	t, h := pingPong(rounds, make(chan int), make(chan int))
+	report("unbuffered:", rounds, t, h)
+	forceGC()
+
+	t, h = pingPong(rounds, make(chan int, 1), make(chan int, 1))
+	report("buffered (1):", rounds, t, h)
+
+	println("")
+	println("done")
+}
@@ -0,0 +1,104 @@
+//go:build ignore
+
+// bench_gc_locality.go - Copy order vs. cache misses after a collection
+//
+// Builds a binary tree breadth-first (so allocation order is no help),
+// collects with each copy order, and times a depth-first walk of the
+// result, like a scene graph render pass. Operand cache misses come from
+// the SH-4 performance counters (PERF_COUNTER_OC_MISS, as in kos/perf.go).
+package main
+
+import _ "unsafe"
+
+//go:linkname nanotime runtime.nanotime
+func nanotime() int64
+
+//go:linkname forceGC runtime.GC
+func forceGC()
+
+//go:linkname setGCDepthFirst runtime.SetGCDepthFirst
+func setGCDepthFirst(enabled bool) bool
+
+//extern perf_cntr_start
+func perfCntrStart(counter int32, mode int32, start uint64)
+
+//extern perf_cntr_stop
+func perfCntrStop(counter int32) uint64
+
+const (
+	perfCounter          = 1 // Counter 0 is kos.PerfCntrStart's cycle count
+	PERF_COUNTER_OC_MISS = 2
+)
+
+type node struct {
+	left, right *node
+	value       int32
+	pad         [5]int32 // 40 bytes with the header
+}
+
+var root *node
+
+// 2^depth - 1 nodes, allocated level by level
+func buildTree(depth int) *node {
+	r := &node{value: 1}
+	level := []*node{r}
+	for d := 1; d < depth; d++ {
+		next := make([]*node, 0, 2*len(level))
+		for _, n := range level {
+			n.left = &node{value: n.value * 2}
+			n.right = &node{value: n.value*2 + 1}
+			next = append(next, n.left, n.right)
+		}
+		level = next
+	}
+	return r
+}
+
+func walk(n *node) int32 {
+	if n == nil {
+		return 0
+	}
+	return n.value + walk(n.left) + walk(n.right)
+}
+
+func bench(name string, depthFirst bool) {
+	setGCDepthFirst(depthFirst)
+	start := nanotime()
+	forceGC()
+	pause := (nanotime() - start) / 1000
+
+	walk(root) // Warm up the walk's own code and stack
+
+	perfCntrStart(perfCounter, PERF_COUNTER_OC_MISS, 0)
+	start = nanotime()
+	const walks = 10
+	var sum int32
+	for i := 0; i < walks; i++ {
+		sum += walk(root)
+	}
+	elapsed := (nanotime() - start) / 1000 / walks
+	misses := perfCntrStop(perfCounter) / walks
+
+	println(name)
+	println("  gc pause:", pause, "us")
+	println("  walk:", elapsed, "us,", misses, "OC misses")
+	_ = sum
+}
+
+func main() {
+	println("bench_gc_locality")
+	println("")
+
+	const depth = 14 // 16383 nodes, 640KB: far beyond the 16KB operand cache
+	root = buildTree(depth)
+	println("tree:", (1<<depth)-1, "nodes")
+	println("")
+
+	old := setGCDepthFirst(false)
+	bench("breadth-first copy (Cheney):", false)
+	bench("depth-first copy:", true)
+	setGCDepthFirst(old)
+
+	println("")
+	println("done")
+}
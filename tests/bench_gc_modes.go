@@ -0,0 +1,108 @@
+//go:build ignore
+
+// bench_gc_modes.go - Copying vs mark-compact collector
+//
+// Build and run once per mode, then compare the two outputs:
+//
+//	make -C .. clean all                     # semispace copying (default)
+//	make -C .. clean all GC_MARK_COMPACT=1   # mark-compact
+package main
+
+import _ "unsafe"
+
+//go:linkname nanotime runtime.nanotime
+func nanotime() int64
+
+//go:linkname forceGC runtime.GC
+func forceGC()
+
+//go:linkname gcMarkCompact runtime.gcMarkCompact
+func gcMarkCompact() bool
+
+//go:linkname gcHeapCapacity runtime.gcHeapCapacity
+func gcHeapCapacity() int64
+
+type node struct {
+	next *node
+	data [56]byte
+}
+
+// Garbage promoted alongside the live list, dropped before each timed GC
+var junk *node
+
+// Build a live list of n nodes interleaved with n nodes of junk
+func buildInterleaved(n int) *node {
+	var head *node
+	for i := 0; i < n; i++ {
+		junk = &node{next: junk}
+		head = &node{next: head}
+	}
+	return head
+}
+
+// Full GC pause with a live set of n*64 bytes. The untimed GC before each
+// measured one promotes the live list interleaved with the same amount of
+// junk, which then dies in the old generation and leaves holes for the
+// compactor to close.
+func benchPause(n int) {
+	println("full GC pause with", n*64/1024, "KB live:")
+
+	var total int64
+	for i := 0; i < 3; i++ {
+		head := buildInterleaved(n)
+		forceGC()
+		junk = nil
+
+		start := nanotime()
+		forceGC()
+		pause := (nanotime() - start) / 1000
+		total += pause
+		println("  cycle", i+1, ":", pause, "us")
+		_ = head
+	}
+	println("  average:", total/3, "us")
+}
+
+// Allocation throughput with a steady live set, including GC time
+func benchThroughput() {
+	println("allocation throughput (64B objects, 256KB live):")
+	live := make([]*node, 4096)
+	for i := range live {
+		live[i] = new(node)
+	}
+	forceGC()
+
+	const n = 200000
+	start := nanotime()
+	for i := 0; i < n; i++ {
+		p := new(node)
+		if i%64 == 0 {
+			live[(i/64)%len(live)] = p
+		}
+	}
+	elapsed := nanotime() - start
+	println("  total:", elapsed/1000000, "ms")
+	println("  per alloc:", elapsed/n, "ns")
+	_ = live[0]
+}
+
+func main() {
+	println("bench_gc_modes")
+	println("")
+
+	if gcMarkCompact() {
+		println("mode: mark-compact")
+	} else {
+		println("mode: semispace copying")
+	}
+	println("usable heap:", gcHeapCapacity()/1024, "KB")
+	println("")
+
+	benchPause(512)
+	benchPause(4096)
+	benchPause(16384)
+	benchThroughput()
+
+	println("")
+	println("done")
+}
@@ -11,6 +11,18 @@ func nanotime() int64
 //go:linkname forceGC runtime.GC
 func forceGC()
 
+//go:linkname gcMinorCount runtime.gcMinorCount
+func gcMinorCount() uint32
+
+//go:linkname gcLastMinorPause runtime.gcLastMinorPause
+func gcLastMinorPause() int64
+
+//go:linkname setGCIncremental runtime.SetGCIncremental
+func setGCIncremental(enabled bool) bool
+
+//go:linkname gcStep runtime.GCStep
+func gcStep(budgetUs uint32) bool
+
 func benchBaseline() {
 	println("baseline (minimal live data):")
 	forceGC()
@@ -76,6 +88,65 @@ func benchWithGarbage() {
 	}
 }
 
+// Short-lived garbage with a large old generation: minor collections only
+// copy nursery survivors, so their pause should not grow with the 128KB.
+func benchMinorPause() {
+	println("minor GC with 128KB old data:")
+	live := make([]*[128]byte, 1024)
+	for i := 0; i < 1024; i++ {
+		live[i] = new([128]byte)
+	}
+	forceGC()
+
+	var keep *[64]byte
+	before := gcMinorCount()
+	var worst int64
+	for frame := 0; frame < 60; frame++ {
+		for i := 0; i < 256; i++ {
+			p := new([64]byte)
+			if i == 0 {
+				keep = p
+			}
+		}
+		if pause := gcLastMinorPause(); pause > worst {
+			worst = pause
+		}
+	}
+	println("  minor GCs:", gcMinorCount()-before)
+	println("  last minor pause:", gcLastMinorPause(), "us")
+	println("  worst minor pause:", worst, "us")
+	_ = live[0]
+	_ = keep
+}
+
+func benchIncremental() {
+	println("incremental with 128KB live data (1ms steps):")
+	live := make([]*[128]byte, 1024)
+	for i := 0; i < 1024; i++ {
+		live[i] = new([128]byte)
+	}
+	forceGC()
+
+	start := nanotime()
+	forceGC()
+	println("  full pause:", (nanotime()-start)/1000, "us")
+
+	setGCIncremental(true)
+	steps := 0
+	var worst int64
+	for more := true; more; steps++ {
+		start = nanotime()
+		more = gcStep(1000)
+		if pause := (nanotime() - start) / 1000; pause > worst {
+			worst = pause
+		}
+	}
+	setGCIncremental(false)
+	println("  steps:", steps)
+	println("  worst step (incl. finish):", worst, "us")
+	_ = live[0]
+}
+
 func main() {
 	println("bench_gc_pause")
 	println("")
@@ -84,6 +155,8 @@ func main() {
 	benchWith32KB()
 	benchWith128KB()
 	benchWithGarbage()
+	benchMinorPause()
+	benchIncremental()
 
 	println("")
 	println("done")
@@ -3,7 +3,7 @@
 // bench_gc_techniques.go - GC optimization techniques benchmark
 package main
 
-import _ "unsafe"
+import "unsafe"
 
 //go:linkname nanotime runtime.nanotime
 func nanotime() int64
@@ -11,6 +11,15 @@ func nanotime() int64
 //go:linkname forceGC runtime.GC
 func forceGC()
 
+//go:linkname newPool runtime.NewPool
+func newPool(proto interface{}) unsafe.Pointer
+
+//go:linkname poolGet runtime.PoolGet
+func poolGet(pool unsafe.Pointer) unsafe.Pointer
+
+//go:linkname poolPut runtime.PoolPut
+func poolPut(pool unsafe.Pointer, obj unsafe.Pointer)
+
 type Bullet struct {
 	X, Y   float32
 	VX, VY float32
@@ -98,12 +107,28 @@ func benchObjectPool() {
 	poolTime := nanotime() - start
 	forceGC()
 
+	// Runtime pool: the free list is trimmed by each collection
+	runtimePool := newPool((*Bullet)(nil))
+	start = nanotime()
+	for i := 0; i < iterations; i++ {
+		b := (*Bullet)(poolGet(runtimePool))
+		b.X = float32(i)
+		b.Active = true
+		b.X, b.Y, b.VX, b.VY = 0, 0, 0, 0
+		b.Active = false
+		poolPut(runtimePool, unsafe.Pointer(b))
+	}
+	runtimePoolTime := nanotime() - start
+	forceGC()
+
 	newAllocNs := newAllocTime / int64(iterations)
 	poolNs := poolTime / int64(iterations)
+	runtimePoolNs := runtimePoolTime / int64(iterations)
 	poolSpeedup := (newAllocTime * 100) / poolTime
 
 	println("  new() each:     ", newAllocNs, "ns/iter")
 	println("  pool reuse:     ", poolNs, "ns/iter")
+	println("  runtime pool:   ", runtimePoolNs, "ns/iter")
 	println("  speedup:        ", poolSpeedup, "% (", poolSpeedup-100, "% faster)")
 }
 
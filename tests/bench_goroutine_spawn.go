@@ -0,0 +1,96 @@
+//go:build ignore
+
+// bench_goroutine_spawn.go - Goroutine spawn and exit latency
+package main
+
+import _ "unsafe"
+
+//go:linkname nanotime runtime.nanotime
+func nanotime() int64
+
+//go:linkname forceGC runtime.GC
+func forceGC()
+
+//go:linkname numGoroutine runtime.NumGoroutine
+func numGoroutine() int
+
+//extern runtime_gosched
+func gosched()
+
+// spawnOneAtATime starts each goroutine after the previous one has
+// exited, so every spawn after the first few reuses a G and a stack
+func spawnOneAtATime(n int) int64 {
+	done := make(chan bool)
+	start := nanotime()
+	for i := 0; i < n; i++ {
+		go func() { done <- true }()
+		<-done
+	}
+	return nanotime() - start
+}
+
+// spawnBurst has n goroutines alive at once, all parked on one channel,
+// then releases them
+func spawnBurst(n int) (int64, int64, int) {
+	release := make(chan bool)
+	done := make(chan bool, n)
+
+	start := nanotime()
+	for i := 0; i < n; i++ {
+		go func() {
+			<-release
+			done <- true
+		}()
+	}
+	spawned := nanotime() - start
+	gosched() // Let them all park
+	live := numGoroutine()
+
+	start = nanotime()
+	close(release)
+	for i := 0; i < n; i++ {
+		<-done
+	}
+	return spawned, nanotime() - start, live
+}
+
+func benchSequential() {
+	println("spawn + exit, one at a time:")
+	const warm = 100
+	const n = 1000
+
+	spawnOneAtATime(warm) // Fill the G free list and stack pool
+	forceGC()
+	t := spawnOneAtATime(n)
+	forceGC()
+
+	println("  goroutines:  ", n)
+	println("  total:       ", t/1000, "us")
+	println("  per spawn:   ", t/int64(n), "ns")
+}
+
+func benchBurst() {
+	println("burst (all alive at once):")
+	sizes := []int{100, 300, 600} // 600 x 8KB stacks is ~5MB
+
+	for _, n := range sizes {
+		spawned, drained, live := spawnBurst(n)
+		forceGC()
+		println("  ", n, "goroutines:", spawned/int64(n), "ns/spawn,",
+			drained/int64(n), "ns/exit, live:", live)
+	}
+}
+
+func main() {
+	println("bench_goroutine_spawn")
+	println("")
+
+	forceGC()
+
+	benchSequential()
+	println("")
+	benchBurst()
+
+	println("")
+	println("done")
+}
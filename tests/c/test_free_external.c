@@ -1,7 +1,8 @@
 // test_free_external.c - Verify large object allocation and freeing
 //
-// Large objects (>64KB) bypass the GC and use malloc directly.
-// This test verifies we can free them with gc_external_free.
+// Large objects (>64KB) skip the semispaces and live in the non-moving
+// large object space. The GC frees them when unreachable; this test also
+// verifies they can be freed early with gc_external_free.
 
 #include <stdio.h>
 #include <stdint.h>
@@ -78,6 +79,33 @@ static void test_multiple_alloc_free(void)
     PASS("multiple alloc/free cycles");
 }
 
+static __attribute__((noinline)) void alloc_unreachable_large(void)
+{
+    uint8_t *p = gc_alloc(200 * 1024, NULL);
+    p[0] = 1;
+}
+
+static void test_large_object_collected(void)
+{
+    uint32_t count_before = gc_heap.large_alloc_count;
+    size_t total_before = gc_heap.large_alloc_total;
+
+    alloc_unreachable_large();
+    if (gc_heap.large_alloc_count != count_before + 1 ||
+        gc_heap.large_alloc_total < total_before + 200 * 1024) {
+        FAIL("large object collected", "stats not updated on alloc");
+        return;
+    }
+
+    gc_collect();
+
+    if (gc_heap.large_alloc_count == count_before &&
+        gc_heap.large_alloc_total == total_before)
+        PASS("large object collected");
+    else
+        FAIL("large object collected", "unreachable object not swept");
+}
+
 static void test_runtime_FreeExternal(void)
 {
     // Test the Go-callable version
@@ -105,6 +133,7 @@ int main(void)
     test_free_external_works();
     test_free_null_safe();
     test_multiple_alloc_free();
+    test_large_object_collected();
     test_runtime_FreeExternal();
     
     printf("\nresult: %d passed, %d failed\n", passed, failed);
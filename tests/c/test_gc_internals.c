@@ -388,6 +388,58 @@ static void test_forwarding_flag(void)
     PASS(name);
 }
 
+// ============================================================================
+// Test 11: Pinned objects do not move and are swept when unreachable
+// ============================================================================
+
+static void *pinned_root;
+
+static __attribute__((noinline)) void alloc_unreachable_pinned(void)
+{
+    uint8_t *p = gc_alloc_pinned(1024, NULL);
+    p[0] = 1;
+}
+
+static void test_pinned_alloc(void)
+{
+    const char *name = "pinned allocation";
+
+    uint8_t *p = gc_alloc_pinned(100, NULL);
+    pinned_root = p;
+    gc_add_root(&pinned_root);
+
+    if (((uintptr_t)p & 31) != 0) {
+        FAIL(name, "not 32-byte aligned");
+        return;
+    }
+    if (gc_in_old_space(p) || gc_in_nursery(p)) {
+        FAIL(name, "allocated in the moving heap");
+        return;
+    }
+    if (!GC_HEADER_IS_NOSCAN(gc_get_header(p))) {
+        FAIL(name, "untyped pinned object not NOSCAN");
+        return;
+    }
+    p[99] = 0x5A;
+
+    alloc_unreachable_pinned();
+    size_t before = gc_pinned_bytes;
+    gc_collect();
+
+    if (pinned_root != p || p[99] != 0x5A) {
+        FAIL(name, "pinned object moved or changed");
+        return;
+    }
+    if (gc_pinned_bytes >= before) {
+        FAIL(name, "unreachable pinned object not freed");
+        return;
+    }
+
+    gc_remove_root(&pinned_root);
+    pinned_root = NULL;
+    PASS(name);
+}
+
 // ============================================================================
 // Main
 // ============================================================================
@@ -411,6 +463,7 @@ int main(void)
     test_no_overlap();
     test_gc_stats();
     test_forwarding_flag();
+    test_pinned_alloc();
 
     printf("\n===========================================\n");
     printf("Passed: %d\n", tests_passed);
@@ -12,6 +12,8 @@ type Player struct {
 
 var globalCounter int = 12345
 
+var smallBoxes [64]*uint64 // Global so the allocations escape
+
 //go:noinline
 func allocOnHeap() *Player {
 	return &Player{X: 10, Y: 20, Score: 100}
@@ -89,6 +91,35 @@ func testDifferentSizes() {
 	println("  []int(10):  ", formatHex(uintptr(unsafe.Pointer(&slice[0]))))
 }
 
+func testSmallObjects() {
+	println("small pointer-free objects (no header, 8-byte slots):")
+
+	for i := range smallBoxes {
+		smallBoxes[i] = new(uint64)
+	}
+
+	// Spacing between consecutive allocations; a step onto a new page
+	// (or a minor GC in between) shows up as an outlier, not the norm
+	const headered = 16 // 8-byte header + 8-byte value
+	tight := 0
+	spacing := int64(headered)
+	for i := 1; i < len(smallBoxes); i++ {
+		diff := int64(uintptr(unsafe.Pointer(smallBoxes[i]))) -
+			int64(uintptr(unsafe.Pointer(smallBoxes[i-1])))
+		if diff > 0 && diff < headered {
+			tight++
+			spacing = diff
+		}
+	}
+	println("  uint64 0 :", formatHex(uintptr(unsafe.Pointer(smallBoxes[0]))))
+	println("  spacing:", spacing, "bytes,", tight, "of", len(smallBoxes)-1, "pairs")
+	if tight >= len(smallBoxes)/2 && spacing < headered {
+		println("  PASS: headerless spacing below", headered, "bytes")
+	} else {
+		println("  FAIL: headerless spacing below", headered, "bytes")
+	}
+}
+
 func testGlobalVariable() {
 	println("global variable:")
 	globalAddr := uintptr(unsafe.Pointer(&globalCounter))
@@ -102,6 +133,7 @@ func main() {
 	testStackVsHeap()
 	testBumpPointer()
 	testDifferentSizes()
+	testSmallObjects()
 	testGlobalVariable()
 
 	println("")
@@ -3,6 +3,45 @@
 // test_goroutines.go - Goroutine and channel tests
 package main
 
+import _ "unsafe"
+
+//go:linkname gcCollect runtime.GC
+func gcCollect()
+
+//go:linkname gcStacksElided runtime.gcStacksElided
+func gcStacksElided() uint32
+
+//go:linkname stackGrowths runtime.stackGrowths
+func stackGrowths() uint32
+
+//go:linkname setSpawnStack runtime.SetSpawnStack
+func setSpawnStack(size uintptr)
+
+//go:linkname setSchedClass runtime.SetSchedClass
+func setSchedClass(class int) int
+
+//go:linkname setDeadline runtime.SetDeadline
+func setDeadline(us int64)
+
+//go:linkname stackSize runtime.stackSize
+func stackSize() uintptr
+
+var parkedSink *[4]int
+var growSink *[4]int
+
+// deepStack recurses with a pointer into its own frame live across the
+// call, allocating at each level so the stack is grown under it
+func deepStack(depth int) int {
+	var frame [32]int
+	p := &frame[depth%32]
+	*p = depth
+	growSink = new([4]int)
+	if depth == 0 {
+		return 0
+	}
+	return deepStack(depth-1) + *p
+}
+
 func testBasicGoroutine() {
 	println("goroutines:")
 	passed := 0
@@ -381,6 +420,42 @@ func testConcurrentPatterns() {
 		println("  FAIL: multiple producers, count:", count)
 	}
 
+	total++
+	order := make(chan int, 2)
+	prevClass := setSchedClass(2) // Goroutines created now are background
+	go func() { order <- 2 }()
+	setSchedClass(prevClass)
+	go func() { order <- 1 }()
+	if first, second := <-order, <-order; first == 1 && second == 2 {
+		passed++
+		println("  PASS: normal before background")
+	} else {
+		println("  FAIL: normal before background, order:", first, second)
+	}
+
+	total++
+	gate := make(chan bool)
+	parked := make(chan bool, 2)
+	prevClass = setSchedClass(0)
+	for _, d := range []int64{50000, 10000} {
+		go func(d int64) {
+			setDeadline(d)
+			parked <- true
+			<-gate
+			order <- int(d)
+		}(d)
+	}
+	setSchedClass(prevClass)
+	<-parked
+	<-parked
+	close(gate) // Wakes them in arrival order; EDF runs 10000 first
+	if first, second := <-order, <-order; first == 10000 && second == 50000 {
+		passed++
+		println("  PASS: earliest deadline first")
+	} else {
+		println("  FAIL: earliest deadline first, order:", first, second)
+	}
+
 	println("  result:", passed, "/", total)
 }
 
@@ -462,6 +537,68 @@ func testStress() {
 	passed++
 	println("  PASS: concurrent allocation")
 
+	total++
+	const parked = 8
+	ready := make(chan bool, parked)
+	held := make(chan bool, parked)
+	wake := make([]chan int, parked)
+	for g := 0; g < parked; g++ {
+		wake[g] = make(chan int)
+		go func(id int) {
+			p := new([4]int)
+			parkedSink = p // Escape, so p is a heap object only this stack holds
+			parkedSink = nil
+			p[0] = id
+			ready <- true
+			v := <-wake[id] // Parked through the collections below
+			held <- p[0] == id && v == id
+		}(g)
+	}
+	for g := 0; g < parked; g++ {
+		<-ready
+	}
+	elided := gcStacksElided()
+	for i := 0; i < 3; i++ {
+		_ = make([]byte, 1024)
+		gcCollect() // Each moves every p; later ones use the slot cache
+	}
+	elided = gcStacksElided() - elided
+	intact := true
+	for g := 0; g < parked; g++ {
+		wake[g] <- g
+		intact = <-held && intact
+	}
+	if intact && elided >= parked {
+		passed++
+		println("  PASS: parked stacks across collections")
+	} else {
+		println("  FAIL: parked stacks across collections, elided:", elided)
+	}
+
+	total++
+	grown := stackGrowths()
+	deep := make(chan int)
+	go func() { deep <- deepStack(150) }()
+	sum := <-deep
+	grown = stackGrowths() - grown
+	if sum == 150*151/2 && grown > 0 {
+		passed++
+		println("  PASS: stack growth (", grown, "moves )")
+	} else {
+		println("  FAIL: stack growth, sum:", sum, "moves:", grown)
+	}
+
+	total++
+	sized := make(chan uintptr)
+	setSpawnStack(32 << 10)
+	go func() { sized <- stackSize() }()
+	if size := <-sized; size >= 32<<10 {
+		passed++
+		println("  PASS: spawn stack hint")
+	} else {
+		println("  FAIL: spawn stack hint, size:", size)
+	}
+
 	println("  result:", passed, "/", total)
 }
 
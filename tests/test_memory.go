@@ -7,6 +7,188 @@ import "unsafe"
 
 var globalPtr *int
 var globalSlice []*int
+var frameJunk []byte
+var smallSink [3]*int64
+var arenaKeep []*int
+
+type snapNode struct {
+	next *snapNode // A pointer keeps it out of the small-object pages
+	id   int
+}
+
+var snapKeep *snapNode
+
+//go:linkname setGCIncremental runtime.SetGCIncremental
+func setGCIncremental(enabled bool) bool
+
+//go:linkname gcStep runtime.GCStep
+func gcStep(budgetUs uint32) bool
+
+//go:linkname allocPinned runtime.AllocPinned
+func allocPinned(size int) []byte
+
+//go:linkname setAllocProfileRate runtime.SetAllocProfileRate
+func setAllocProfileRate(rate int) int
+
+//go:linkname allocProfileSamples runtime.allocProfileSamples
+func allocProfileSamples() uint32
+
+//go:linkname gcFrameEnd runtime.GCFrameEnd
+func gcFrameEnd() bool
+
+//go:linkname setGCPauseBudget runtime.SetGCPauseBudget
+func setGCPauseBudget(us int32) int32
+
+//go:linkname setGCHeapGoal runtime.SetGCHeapGoal
+func setGCHeapGoal(bytes int) int
+
+//go:linkname gcScanPlans runtime.gcScanPlans
+func gcScanPlans() uint32
+
+//go:linkname gcPrezeroAll runtime.gcPrezeroAll
+func gcPrezeroAll() int32
+
+//go:linkname newArena runtime.NewArena
+func newArena(size int) unsafe.Pointer
+
+//go:linkname setArena runtime.SetArena
+func setArena(a unsafe.Pointer) unsafe.Pointer
+
+//go:linkname resetArena runtime.ResetArena
+func resetArena(a unsafe.Pointer)
+
+//go:linkname freeArena runtime.FreeArena
+func freeArena(a unsafe.Pointer)
+
+//go:linkname arenaUsed runtime.ArenaUsed
+func arenaUsed(a unsafe.Pointer) int
+
+//go:linkname newPool runtime.NewPool
+func newPool(proto interface{}) unsafe.Pointer
+
+//go:linkname poolGet runtime.PoolGet
+func poolGet(pool unsafe.Pointer) unsafe.Pointer
+
+//go:linkname poolPut runtime.PoolPut
+func poolPut(pool unsafe.Pointer, obj unsafe.Pointer)
+
+//go:linkname gcCollect runtime.GC
+func gcCollect()
+
+//go:linkname gcHeapCapacity runtime.gcHeapCapacity
+func gcHeapCapacity() int64
+
+//go:linkname setHeapSize runtime.SetHeapSize
+func setHeapSize(bytes int) bool
+
+//go:linkname setMemoryLimit debug.SetMemoryLimit
+func setMemoryLimit(limit int64) int64
+
+//go:linkname notifyLowMemory runtime.NotifyLowMemory
+func notifyLowMemory(ch chan int)
+
+//go:linkname writeHeapSnapshot runtime.WriteHeapSnapshot
+func writeHeapSnapshot(path string) bool
+
+//go:linkname gcMatureBytes runtime.gcMatureBytes
+func gcMatureBytes() uintptr
+
+// Mirrors gc_trace_record_t
+type gcTraceRecord struct {
+	Seq, Kind, StartUs, TotalUs                        uint32
+	RootsUs, GlobalsUs, StacksUs, ScanUs, InvalidateUs uint32
+	BytesCopied, ObjectsCopied, HeapBefore, HeapAfter  uint32
+}
+
+//go:linkname readGCTrace runtime.ReadGCTrace
+func readGCTrace(records []gcTraceRecord) int
+
+//extern fs_open
+func fsOpen(path *byte, mode int32) int32
+
+//extern fs_read
+func fsRead(fd int32, buf unsafe.Pointer, count int32) int32
+
+//extern fs_close
+func fsClose(fd int32) int32
+
+// Reads a heap snapshot back as little-endian 32-bit words
+type snapReader struct {
+	fd   int32
+	buf  [512]byte
+	n, i int
+}
+
+func (r *snapReader) word() (uint32, bool) {
+	if r.i+4 > r.n {
+		r.n = copy(r.buf[:], r.buf[r.i:r.n])
+		r.i = 0
+		if got := fsRead(r.fd, unsafe.Pointer(&r.buf[r.n]), int32(len(r.buf)-r.n)); got > 0 {
+			r.n += int(got)
+		}
+		if r.n < 4 {
+			return 0, false
+		}
+	}
+	b := r.buf[r.i : r.i+4]
+	r.i += 4
+	return uint32(b[0]) | uint32(b[1])<<8 | uint32(b[2])<<16 | uint32(b[3])<<24, true
+}
+
+// Checks the snapshot header ("GODCHEAP", version 1) and walks the
+// records (gc_snapshot.c) to the end, looking for an object at addr
+func snapshotHasObject(path string, addr uintptr) bool {
+	cpath := make([]byte, len(path)+1)
+	copy(cpath, path)
+	r := &snapReader{fd: fsOpen(&cpath[0], 0)}
+	if r.fd < 0 {
+		return false
+	}
+	defer fsClose(r.fd)
+
+	var header [6]uint32
+	for i := range header {
+		w, ok := r.word()
+		if !ok {
+			return false
+		}
+		header[i] = w
+	}
+	if header[0] != 0x43444f47 || header[1] != 0x50414548 || header[2] != 1 {
+		return false // "GODC" "HEAP" version
+	}
+
+	found := false
+	for {
+		tag, ok := r.word()
+		if !ok {
+			return false // Truncated
+		}
+		var rec [4]uint32
+		n := 0
+		switch tag {
+		case 0: // End: object count
+			count, ok := r.word()
+			return ok && count > 0 && found
+		case 1: // Root: slot, value
+			n = 2
+		case 2: // Object: address, size, type, flags
+			n = 4
+		case 3: // Edge: value
+			n = 1
+		default:
+			return false
+		}
+		for i := 0; i < n; i++ {
+			if rec[i], ok = r.word(); !ok {
+				return false
+			}
+		}
+		if tag == 2 && uintptr(rec[0]) == addr {
+			found = true
+		}
+	}
+}
 
 func forceGC() {
 	for i := 0; i < 100; i++ {
@@ -500,6 +682,404 @@ func testGC() {
 		println("  FAIL: deep nesting")
 	}
 
+	total++
+	type Holder struct {
+		items [16]*int
+	}
+	holder := &Holder{}
+	forceGC() // holder is promoted out of the nursery
+	for i := 0; i < 16; i++ {
+		v := i + 100
+		holder.items[i] = &v
+	}
+	forceGC()
+	correct = true
+	for i := 0; i < 16; i++ {
+		if holder.items[i] == nil || *holder.items[i] != i+100 {
+			correct = false
+			break
+		}
+	}
+	if correct {
+		passed++
+		println("  PASS: old-to-young pointers")
+	} else {
+		println("  FAIL: old-to-young pointers")
+	}
+
+	total++
+	m := make(map[int]*int)
+	for i := 0; i < 8; i++ {
+		v := i
+		m[i] = &v
+	}
+	forceGC()
+	for i := 8; i < 64; i++ {
+		v := i
+		m[i] = &v
+	}
+	forceGC()
+	correct = len(m) == 64
+	for i := 0; i < 64 && correct; i++ {
+		if p, ok := m[i]; !ok || *p != i {
+			correct = false
+		}
+	}
+	if correct {
+		passed++
+		println("  PASS: map in old generation")
+	} else {
+		println("  FAIL: map in old generation")
+	}
+
+	total++
+	ch := make(chan *int, 8)
+	forceGC()
+	for i := 0; i < 8; i++ {
+		v := i * 7
+		ch <- &v
+	}
+	forceGC()
+	correct = true
+	for i := 0; i < 8; i++ {
+		if p := <-ch; *p != i*7 {
+			correct = false
+		}
+	}
+	if correct {
+		passed++
+		println("  PASS: channel buffer in old generation")
+	} else {
+		println("  FAIL: channel buffer in old generation")
+	}
+
+	total++
+	type pair struct {
+		n    int
+		next *pair
+	}
+	var chain *pair
+	for i := 0; i < 32; i++ {
+		chain = &pair{n: i, next: chain}
+	}
+	wasIncremental := setGCIncremental(true)
+	gcStep(0)
+	for p := chain; p != nil; p = p.next {
+		p.n *= 2
+	}
+	chain = &pair{n: 64, next: chain}
+	for gcStep(50) {
+		_ = make([]byte, 100)
+	}
+	setGCIncremental(wasIncremental)
+	correct = chain.n == 64
+	i := 31
+	for p := chain.next; p != nil && correct; p = p.next {
+		correct = p.n == i*2
+		i--
+	}
+	if correct && i == -1 {
+		passed++
+		println("  PASS: incremental cycle with mutation")
+	} else {
+		println("  FAIL: incremental cycle with mutation")
+	}
+
+	total++
+	buf := make([]byte, 256)
+	for i := range buf {
+		buf[i] = byte(i)
+	}
+	tail := buf[100:]
+	third := &buf[3]
+	buf = nil
+	words := []int{10, 20, 30, 40}
+	elem := &words[2]
+	words = nil
+	forceGC()
+	forceGC()
+	if tail[0] == 100 && tail[155] == 255 && *third == 3 && *elem == 30 {
+		passed++
+		println("  PASS: interior pointers")
+	} else {
+		println("  FAIL: interior pointers")
+	}
+
+	total++
+	pinned := allocPinned(4096)
+	pinnedAddr := uintptr(unsafe.Pointer(&pinned[0]))
+	pinned[4095] = 0x5A
+	pinnedTail := pinned[2048:]
+	pinned = nil
+	forceGC()
+	forceGC()
+	if uintptr(unsafe.Pointer(&pinnedTail[0])) == pinnedAddr+2048 &&
+		pinnedAddr&31 == 0 && pinnedTail[2047] == 0x5A {
+		passed++
+		println("  PASS: pinned allocation")
+	} else {
+		println("  FAIL: pinned allocation")
+	}
+
+	total++
+	oldRate := setAllocProfileRate(512)
+	var sampled [][]int
+	for i := 0; i < 64; i++ {
+		sampled = append(sampled, make([]int, 32))
+	}
+	samples := allocProfileSamples()
+	setAllocProfileRate(0)
+	// 64 x 128 bytes at one sample per ~512 bytes
+	if oldRate == 0 && samples >= 4 && samples <= 64 && len(sampled) == 64 &&
+		allocProfileSamples() == 0 {
+		passed++
+		println("  PASS: allocation profiler")
+	} else {
+		println("  FAIL: allocation profiler")
+	}
+
+	total++
+	traceKeep := make([]*[64]byte, 64)
+	for i := range traceKeep {
+		traceKeep[i] = new([64]byte)
+	}
+	forceGC()
+	var trace [4]gcTraceRecord
+	n := readGCTrace(trace[:])
+	last := trace[3]
+	if n == 4 && trace[0].Seq+3 == last.Seq &&
+		last.RootsUs+last.GlobalsUs+last.StacksUs+last.ScanUs == last.TotalUs &&
+		last.HeapBefore > 0 && traceKeep[63] != nil {
+		passed++
+		println("  PASS: gc trace records")
+	} else {
+		println("  FAIL: gc trace records")
+	}
+
+	total++
+	fresh := make([]*[64]byte, 200)
+	for i := range fresh {
+		fresh[i] = new([64]byte)
+		for j := range fresh[i] {
+			fresh[i][j] = 0xA5
+		}
+	}
+	fresh = make([]*[64]byte, 200)
+	forceGC()
+	chunks := gcPrezeroAll()
+	clean := true
+	for i := range fresh {
+		fresh[i] = new([64]byte)
+		for _, b := range fresh[i] {
+			clean = clean && b == 0
+		}
+	}
+	if chunks > 0 && clean && gcPrezeroAll() == 0 {
+		passed++
+		println("  PASS: pre-zeroed allocation")
+	} else {
+		println("  FAIL: pre-zeroed allocation")
+	}
+
+	total++
+	oldBudget := setGCPauseBudget(2000)
+	oldGoal := setGCHeapGoal(512 * 1024)
+	var first [1]gcTraceRecord
+	readGCTrace(first[:])
+	frameCollects := 0
+	for frame := 0; frame < 40; frame++ {
+		// Too big for the nursery: 40KB of semispace growth per frame
+		frameJunk = make([]byte, 40000)
+		frameJunk[0] = byte(frame)
+		if gcFrameEnd() {
+			frameCollects++
+		}
+	}
+	setGCHeapGoal(oldGoal)
+	var paced [32]gcTraceRecord
+	full := 0
+	for _, r := range paced[:readGCTrace(paced[:])] {
+		if r.Seq > first[0].Seq && (r.Kind == 0 || r.Kind == 2) {
+			full++
+		}
+	}
+	if oldBudget == 2000 && oldGoal == 0 && full > 0 && full <= frameCollects {
+		passed++
+		println("  PASS: paced frame collections")
+	} else {
+		println("  FAIL: paced frame collections")
+	}
+
+	total++
+	// Over 16K pointer words: gccgo describes the layout with a GC program
+	type entity struct {
+		next *int
+		pad  [3]int
+	}
+	plansBefore := gcScanPlans()
+	entities := new([5000]entity)
+	for i := range entities {
+		v := i
+		entities[i].next = &v
+	}
+	forceGC()
+	forceGC()
+	if *entities[0].next == 0 && *entities[4999].next == 4999 &&
+		gcScanPlans() > plansBefore {
+		passed++
+		println("  PASS: scan plans")
+	} else {
+		println("  FAIL: scan plans")
+	}
+
+	total++
+	// Pointer-free and at most 16 bytes: slots in a shared page, no header
+	for i := range smallSink {
+		smallSink[i] = new(int64)
+		*smallSink[i] = int64(i + 1)
+	}
+	slot0 := uintptr(unsafe.Pointer(smallSink[0]))
+	slot1 := uintptr(unsafe.Pointer(smallSink[1]))
+	slot2 := uintptr(unsafe.Pointer(smallSink[2]))
+	adjacent := slot1-slot0 == 8 || slot2-slot1 == 8 // One may start a page
+	boxes := make([]interface{}, 3000)               // Several pages
+	for i := range boxes {
+		boxes[i] = int64(1000 + i)
+	}
+	word := string([]byte("headerless!"))[3:9] // Interior of a 16-byte slot
+	forceGC()
+	boxed := true
+	for i, x := range boxes {
+		boxed = boxed && x.(int64) == int64(1000+i)
+	}
+	if adjacent && boxed && word == "derles" &&
+		*smallSink[0] == 1 && *smallSink[1] == 2 && *smallSink[2] == 3 {
+		passed++
+		println("  PASS: headerless small objects")
+	} else {
+		println("  FAIL: headerless small objects")
+	}
+
+	total++
+	arena := newArena(16 << 10)
+	heapInt := new(int)
+	*heapInt = 77
+	prevArena := setArena(arena)
+	arenaKeep = make([]*int, 8) // From the arena, pointing into the heap
+	arenaKeep[0] = heapInt
+	setArena(prevArena)
+	used := arenaUsed(arena)
+	forceGC() // Moves heapInt; the arena is a root region
+	survived := *arenaKeep[0] == 77
+	arenaKeep = nil
+	resetArena(arena)
+	if prevArena == nil && used >= 8*4 && survived && arenaUsed(arena) == 0 {
+		passed++
+		println("  PASS: frame arena")
+	} else {
+		println("  FAIL: frame arena")
+	}
+	freeArena(arena)
+
+	total++
+	type pooled struct {
+		id   int
+		next *pooled
+	}
+	pool := newPool((*pooled)(nil))
+	item := (*pooled)(poolGet(pool))
+	freshItem := item.id == 0
+	item.id = 5
+	poolPut(pool, unsafe.Pointer(item))
+	gcCollect() // Pooled -> victim at a full GC, moved with its pointer updated
+	item = (*pooled)(poolGet(pool))
+	reused := item.id == 5
+	poolPut(pool, unsafe.Pointer(item))
+	gcCollect()
+	gcCollect() // Idle for two full GCs: dropped
+	item = (*pooled)(poolGet(pool))
+	if freshItem && reused && item.id == 0 {
+		passed++
+		println("  PASS: runtime object pool")
+	} else {
+		println("  FAIL: runtime object pool")
+	}
+
+	total++
+	capacity := gcHeapCapacity()
+	kept := new(int)
+	*kept = 99
+	shrunk := setHeapSize(int(capacity / 2))
+	halved := gcHeapCapacity() == capacity/2
+	grown := setHeapSize(int(capacity))
+	if shrunk && halved && grown && gcHeapCapacity() == capacity && *kept == 99 {
+		passed++
+		println("  PASS: heap resize")
+	} else {
+		println("  FAIL: heap resize")
+	}
+
+	total++
+	lowMem := make(chan int, 1)
+	notifyLowMemory(lowMem)
+	ballast := make([]byte, 32<<10)
+	oldLimit := setMemoryLimit(16 << 10) // Below the ballast alone
+	gcCollect()
+	inUse := 0
+	select {
+	case inUse = <-lowMem:
+	default:
+	}
+	setMemoryLimit(oldLimit)
+	notifyLowMemory(nil)
+	if oldLimit == 1<<63-1 && inUse >= len(ballast) {
+		passed++
+		println("  PASS: memory limit notification")
+	} else {
+		println("  FAIL: memory limit notification")
+	}
+
+	total++
+	snapKeep = &snapNode{id: 7}
+	// Written to the ramdisk: no dcload host needed
+	written := writeHeapSnapshot("/ram/heap.snap")
+	snapAddr := uintptr(unsafe.Pointer(snapKeep)) // Where the snapshot's GC left it
+	if written && !writeHeapSnapshot("") &&
+		snapshotHasObject("/ram/heap.snap", snapAddr) {
+		passed++
+		println("  PASS: heap snapshot")
+	} else {
+		println("  FAIL: heap snapshot")
+	}
+
+	total++
+	type levelTile struct {
+		id   int
+		next *levelTile
+		pad  [10]int
+	}
+	var tiles *levelTile
+	for i := 0; i < 256; i++ { // 12KB that outlives every collection
+		tiles = &levelTile{id: i, next: tiles}
+	}
+	for i := 0; i < 5; i++ {
+		gcCollect() // Survivors, pretenured, then moved to the mature region
+	}
+	tilesOK := true
+	want := 255
+	for t := tiles; t != nil; t = t.next {
+		tilesOK = tilesOK && t.id == want
+		want--
+	}
+	late := &levelTile{id: 1000, next: tiles} // Allocated pretenured
+	gcCollect()
+	if tilesOK && want == -1 && gcMatureBytes() >= 256*unsafe.Sizeof(*tiles) && late.next == tiles {
+		passed++
+		println("  PASS: pretenured long-lived type")
+	} else {
+		println("  FAIL: pretenured long-lived type")
+	}
+
 	println("  result:", passed, "/", total)
 }
 
@@ -0,0 +1,3 @@
+module allocprof
+
+go 1.21
@@ -0,0 +1,298 @@
+// allocprof symbolizes an allocation profile written by
+// runtime.WriteAllocProfile against the game's ELF.
+//
+// Usage:
+//
+//	go run . [-top n] [-stacks] game.elf alloc.prof
+//
+// Each record is one (type, call stack) pair. Samples are scaled by the
+// profile rate to estimate the real allocation volume: an allocation of
+// s bytes is sampled with probability about s/rate.
+package main
+
+import (
+	"bytes"
+	"debug/dwarf"
+	"debug/elf"
+	"encoding/binary"
+	"errors"
+	"flag"
+	"fmt"
+	"io"
+	"os"
+	"sort"
+	"strings"
+)
+
+const magic = "GODCAPRF"
+
+type record struct {
+	typ     uint32
+	samples uint32
+	bytes   uint32
+	pcs     []uint32
+
+	estObjs  float64
+	estBytes float64
+}
+
+type profile struct {
+	rate    uint32
+	dropped uint32
+	records []record
+}
+
+func readProfile(path string) (*profile, error) {
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	if len(data) < 28 || string(data[:8]) != magic {
+		return nil, errors.New("not an allocation profile")
+	}
+
+	r := bytes.NewReader(data[8:])
+	var hdr [5]uint32
+	if err := binary.Read(r, binary.LittleEndian, &hdr); err != nil {
+		return nil, err
+	}
+	if hdr[0] != 1 {
+		return nil, fmt.Errorf("unsupported profile version %d", hdr[0])
+	}
+	p := &profile{rate: hdr[1], dropped: hdr[4]}
+	depth := hdr[2]
+
+	for i := uint32(0); i < hdr[3]; i++ {
+		rec := make([]uint32, 4+depth)
+		if err := binary.Read(r, binary.LittleEndian, rec); err != nil {
+			return nil, fmt.Errorf("record %d: %v", i, err)
+		}
+		frames := rec[3]
+		if frames > depth {
+			return nil, fmt.Errorf("record %d: bad frame count", i)
+		}
+		p.records = append(p.records, record{
+			typ:     rec[0],
+			samples: rec[1],
+			bytes:   rec[2],
+			pcs:     rec[4 : 4+frames],
+		})
+	}
+	return p, nil
+}
+
+type symbol struct {
+	addr, size uint64
+	name       string
+}
+
+type line struct {
+	addr uint64
+	file string
+	line int
+}
+
+type image struct {
+	f     *elf.File
+	funcs []symbol
+	objs  []symbol
+	lines []line
+}
+
+func openImage(path string) (*image, error) {
+	f, err := elf.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	img := &image{f: f}
+
+	syms, err := f.Symbols()
+	if err != nil {
+		return nil, err
+	}
+	for _, s := range syms {
+		// sh-elf prefixes C and Go symbols with an underscore
+		sym := symbol{s.Value, s.Size, strings.TrimPrefix(s.Name, "_")}
+		switch elf.ST_TYPE(s.Info) {
+		case elf.STT_FUNC:
+			img.funcs = append(img.funcs, sym)
+		case elf.STT_OBJECT:
+			img.objs = append(img.objs, sym)
+		}
+	}
+	sort.Slice(img.funcs, func(i, j int) bool { return img.funcs[i].addr < img.funcs[j].addr })
+	sort.Slice(img.objs, func(i, j int) bool { return img.objs[i].addr < img.objs[j].addr })
+
+	// Line numbers are optional: only builds with -g have them
+	if d, err := f.DWARF(); err == nil {
+		img.lines = readLines(d)
+	}
+	return img, nil
+}
+
+func readLines(d *dwarf.Data) []line {
+	var lines []line
+	r := d.Reader()
+	for {
+		cu, err := r.Next()
+		if err != nil || cu == nil {
+			break
+		}
+		if cu.Tag != dwarf.TagCompileUnit {
+			r.SkipChildren()
+			continue
+		}
+		lr, err := d.LineReader(cu)
+		if err != nil || lr == nil {
+			continue
+		}
+		var e dwarf.LineEntry
+		for lr.Next(&e) == nil {
+			if e.File != nil && !e.EndSequence {
+				lines = append(lines, line{e.Address, e.File.Name, e.Line})
+			}
+		}
+	}
+	sort.Slice(lines, func(i, j int) bool { return lines[i].addr < lines[j].addr })
+	return lines
+}
+
+func lookup(syms []symbol, addr uint64) *symbol {
+	i := sort.Search(len(syms), func(i int) bool { return syms[i].addr > addr })
+	if i == 0 {
+		return nil
+	}
+	s := &syms[i-1]
+	if s.size != 0 && addr >= s.addr+s.size {
+		return nil
+	}
+	return s
+}
+
+// Return addresses point past the call (and its delay slot); look up
+// the call instruction itself.
+func (img *image) frame(pc uint32) (fn, pos string) {
+	addr := uint64(pc) - 2
+	fn = fmt.Sprintf("0x%08x", pc)
+	if s := lookup(img.funcs, addr); s != nil {
+		fn = fmt.Sprintf("%s+0x%x", s.name, addr-s.addr)
+	}
+	i := sort.Search(len(img.lines), func(i int) bool { return img.lines[i].addr > addr })
+	if i > 0 {
+		l := img.lines[i-1]
+		pos = fmt.Sprintf("%s:%d", l.file, l.line)
+	}
+	return fn, pos
+}
+
+func (img *image) read(addr uint64, n int) []byte {
+	for _, s := range img.f.Sections {
+		if s.Type != elf.SHT_PROGBITS || addr < s.Addr || addr+uint64(n) > s.Addr+s.Size {
+			continue
+		}
+		buf := make([]byte, n)
+		if _, err := s.ReadAt(buf, int64(addr-s.Addr)); err != nil && err != io.EOF {
+			return nil
+		}
+		return buf
+	}
+	return nil
+}
+
+// typeName reads the descriptor's reflection string (offset 24, a
+// pointer to a Go string), falling back to the symbol name.
+func (img *image) typeName(addr uint32) string {
+	if addr == 0 {
+		return "<untyped>"
+	}
+	if desc := img.read(uint64(addr), 36); desc != nil {
+		if str := img.read(uint64(binary.LittleEndian.Uint32(desc[24:])), 8); str != nil {
+			data := binary.LittleEndian.Uint32(str[0:])
+			n := binary.LittleEndian.Uint32(str[4:])
+			if n < 256 {
+				if name := img.read(uint64(data), int(n)); name != nil {
+					return string(name)
+				}
+			}
+		}
+	}
+	if s := lookup(img.objs, uint64(addr)); s != nil {
+		return s.name
+	}
+	return fmt.Sprintf("type@0x%08x", addr)
+}
+
+// Runtime frames between gc_alloc and the allocating code
+func isRuntime(fn string) bool {
+	for _, p := range []string{"gc_", "runtime.", "runtime_", "__go_", "0x"} {
+		if strings.HasPrefix(fn, p) {
+			return true
+		}
+	}
+	return false
+}
+
+func main() {
+	top := flag.Int("top", 20, "records to show (0 = all)")
+	stacks := flag.Bool("stacks", false, "print full call stacks")
+	flag.Usage = func() {
+		fmt.Fprintln(os.Stderr, "usage: allocprof [-top n] [-stacks] game.elf alloc.prof")
+		flag.PrintDefaults()
+	}
+	flag.Parse()
+	if flag.NArg() != 2 {
+		flag.Usage()
+		os.Exit(2)
+	}
+
+	img, err := openImage(flag.Arg(0))
+	if err != nil {
+		fmt.Fprintln(os.Stderr, "allocprof:", err)
+		os.Exit(1)
+	}
+	p, err := readProfile(flag.Arg(1))
+	if err != nil {
+		fmt.Fprintln(os.Stderr, "allocprof:", err)
+		os.Exit(1)
+	}
+
+	var totalBytes float64
+	for i := range p.records {
+		r := &p.records[i]
+		avg := float64(r.bytes) / float64(r.samples)
+		r.estObjs = float64(r.samples)
+		if avg > 0 && avg < float64(p.rate) {
+			r.estObjs *= float64(p.rate) / avg
+		}
+		r.estBytes = r.estObjs * avg
+		totalBytes += r.estBytes
+	}
+	sort.Slice(p.records, func(i, j int) bool { return p.records[i].estBytes > p.records[j].estBytes })
+
+	fmt.Printf("rate %d bytes, %d records, %d samples dropped (table full)\n",
+		p.rate, len(p.records), p.dropped)
+	fmt.Printf("%12s %6s %10s %8s  %-24s %s\n", "est. bytes", "%", "est. objs", "samples", "type", "site")
+
+	for i, r := range p.records {
+		if *top > 0 && i == *top {
+			break
+		}
+		site := "?"
+		for _, pc := range r.pcs {
+			fn, pos := img.frame(pc)
+			if !isRuntime(fn) {
+				site = strings.TrimSpace(fn + " " + pos)
+				break
+			}
+		}
+		fmt.Printf("%12.0f %5.1f%% %10.0f %8d  %-24s %s\n", r.estBytes,
+			100*r.estBytes/totalBytes, r.estObjs, r.samples, img.typeName(r.typ), site)
+
+		if *stacks {
+			for _, pc := range r.pcs {
+				fn, pos := img.frame(pc)
+				fmt.Printf("%14s %s %s\n", "", fn, pos)
+			}
+		}
+	}
+}
@@ -0,0 +1,3 @@
+module heapsnap
+
+go 1.21
@@ -0,0 +1,489 @@
+// heapsnap analyzes a heap snapshot written by runtime.WriteHeapSnapshot
+// against the game's ELF.
+//
+// Usage:
+//
+//	go run . [-top n] [-paths n] game.elf heap.snap
+//
+// The snapshot holds every live object and the pointers the collector
+// follows: root slots, and each object's fields from its gcdata. heapsnap
+// builds the dominator tree of that graph. An object's retained size is
+// what a collection would free if the object became unreachable: itself
+// and everything only reachable through it. The report lists retained
+// size by type, then the objects retaining the most with their dominator
+// path from a root.
+package main
+
+import (
+	"bytes"
+	"debug/elf"
+	"encoding/binary"
+	"errors"
+	"flag"
+	"fmt"
+	"io"
+	"os"
+	"sort"
+	"strings"
+)
+
+const magic = "GODCHEAP"
+
+// Record tags and object flags (gc_snapshot.c)
+const (
+	recEnd = iota
+	recRoot
+	recObject
+	recEdge
+)
+
+const (
+	flagPinned    = 1
+	flagNursery   = 2
+	flagSmallPage = 4
+	flagMature    = 8
+)
+
+type object struct {
+	addr  uint32 // User pointer; the 8-byte header precedes it
+	size  uint32 // Including the header
+	typ   uint32
+	flags uint32
+	edges []uint32
+}
+
+type root struct {
+	slot, value uint32
+}
+
+type snapshot struct {
+	spaceSize, inUse, gcCount uint32
+	roots                     []root
+	objects                   []object
+}
+
+func readSnapshot(path string) (*snapshot, error) {
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	if len(data) < 24 || string(data[:8]) != magic {
+		return nil, errors.New("not a heap snapshot")
+	}
+
+	r := bytes.NewReader(data[8:])
+	var hdr [4]uint32
+	if err := binary.Read(r, binary.LittleEndian, &hdr); err != nil {
+		return nil, err
+	}
+	if hdr[0] != 1 {
+		return nil, fmt.Errorf("unsupported snapshot version %d", hdr[0])
+	}
+	s := &snapshot{spaceSize: hdr[1], inUse: hdr[2], gcCount: hdr[3]}
+
+	word := func() (uint32, error) {
+		var w uint32
+		err := binary.Read(r, binary.LittleEndian, &w)
+		if err == io.EOF {
+			err = errors.New("truncated snapshot")
+		}
+		return w, err
+	}
+	for {
+		tag, err := word()
+		if err != nil {
+			return nil, err
+		}
+		var f [4]uint32
+		n := map[uint32]int{recEnd: 1, recRoot: 2, recObject: 4, recEdge: 1}[tag]
+		if n == 0 {
+			return nil, fmt.Errorf("bad record tag %d", tag)
+		}
+		for i := 0; i < n; i++ {
+			if f[i], err = word(); err != nil {
+				return nil, err
+			}
+		}
+		switch tag {
+		case recEnd:
+			if int(f[0]) != len(s.objects) {
+				return nil, fmt.Errorf("%d objects, end record says %d", len(s.objects), f[0])
+			}
+			return s, nil
+		case recRoot:
+			s.roots = append(s.roots, root{f[0], f[1]})
+		case recObject:
+			s.objects = append(s.objects, object{addr: f[0], size: f[1], typ: f[2], flags: f[3]})
+		case recEdge:
+			if len(s.objects) == 0 {
+				return nil, errors.New("edge before any object")
+			}
+			o := &s.objects[len(s.objects)-1]
+			o.edges = append(o.edges, f[0])
+		}
+	}
+}
+
+// find returns the object containing addr (interior pointers included),
+// or -1. objects must be sorted by address.
+func find(objects []object, addr uint32) int {
+	i := sort.Search(len(objects), func(i int) bool { return objects[i].addr-8 > addr })
+	if i == 0 {
+		return -1
+	}
+	o := &objects[i-1]
+	if addr >= o.addr-8+o.size {
+		return -1
+	}
+	return i - 1
+}
+
+// graph is the object graph with node 0 as a virtual root whose
+// successors are the objects referenced from root slots.
+type graph struct {
+	succ, pred [][]int
+	rootSlot   map[int]uint32 // First root slot seen for each object node
+}
+
+func buildGraph(s *snapshot) *graph {
+	n := len(s.objects) + 1
+	g := &graph{succ: make([][]int, n), pred: make([][]int, n), rootSlot: map[int]uint32{}}
+
+	add := func(from, to int) {
+		for _, x := range g.succ[from] {
+			if x == to {
+				return
+			}
+		}
+		g.succ[from] = append(g.succ[from], to)
+		g.pred[to] = append(g.pred[to], from)
+	}
+	for _, r := range s.roots {
+		if i := find(s.objects, r.value); i >= 0 {
+			if _, ok := g.rootSlot[i+1]; !ok {
+				g.rootSlot[i+1] = r.slot
+			}
+			add(0, i+1)
+		}
+	}
+	for i, o := range s.objects {
+		for _, v := range o.edges {
+			if j := find(s.objects, v); j >= 0 && j != i {
+				add(i+1, j+1)
+			}
+		}
+	}
+	return g
+}
+
+// dominators returns the immediate dominator of every node (-1 if
+// unreachable) and the reachable nodes in reverse postorder, using the
+// Cooper-Harvey-Kennedy iteration.
+func dominators(g *graph) (idom []int, rpo []int) {
+	n := len(g.succ)
+	order := make([]int, n) // Postorder number, -1 = unreachable
+	for i := range order {
+		order[i] = -1
+	}
+
+	// Iterative DFS; a node is numbered once all its successors are done
+	type frame struct{ node, next int }
+	visited := make([]bool, n)
+	stack := []frame{{0, 0}}
+	visited[0] = true
+	var post []int
+	for len(stack) > 0 {
+		top := &stack[len(stack)-1]
+		if top.next < len(g.succ[top.node]) {
+			s := g.succ[top.node][top.next]
+			top.next++
+			if !visited[s] {
+				visited[s] = true
+				stack = append(stack, frame{s, 0})
+			}
+			continue
+		}
+		order[top.node] = len(post)
+		post = append(post, top.node)
+		stack = stack[:len(stack)-1]
+	}
+	for i := len(post) - 1; i >= 0; i-- {
+		rpo = append(rpo, post[i])
+	}
+
+	idom = make([]int, n)
+	for i := range idom {
+		idom[i] = -1
+	}
+	idom[0] = 0
+
+	intersect := func(a, b int) int {
+		for a != b {
+			for order[a] < order[b] {
+				a = idom[a]
+			}
+			for order[b] < order[a] {
+				b = idom[b]
+			}
+		}
+		return a
+	}
+	for changed := true; changed; {
+		changed = false
+		for _, b := range rpo[1:] {
+			d := -1
+			for _, p := range g.pred[b] {
+				if idom[p] < 0 {
+					continue
+				}
+				if d < 0 {
+					d = p
+				} else {
+					d = intersect(p, d)
+				}
+			}
+			if d != idom[b] {
+				idom[b] = d
+				changed = true
+			}
+		}
+	}
+	return idom, rpo
+}
+
+type symbol struct {
+	addr, size uint64
+	name       string
+}
+
+type image struct {
+	f    *elf.File
+	objs []symbol
+}
+
+func openImage(path string) (*image, error) {
+	f, err := elf.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	img := &image{f: f}
+
+	syms, err := f.Symbols()
+	if err != nil {
+		return nil, err
+	}
+	for _, s := range syms {
+		// sh-elf prefixes C and Go symbols with an underscore
+		if elf.ST_TYPE(s.Info) == elf.STT_OBJECT {
+			img.objs = append(img.objs, symbol{s.Value, s.Size, strings.TrimPrefix(s.Name, "_")})
+		}
+	}
+	sort.Slice(img.objs, func(i, j int) bool { return img.objs[i].addr < img.objs[j].addr })
+	return img, nil
+}
+
+func lookup(syms []symbol, addr uint64) *symbol {
+	i := sort.Search(len(syms), func(i int) bool { return syms[i].addr > addr })
+	if i == 0 {
+		return nil
+	}
+	s := &syms[i-1]
+	if s.size != 0 && addr >= s.addr+s.size {
+		return nil
+	}
+	return s
+}
+
+func (img *image) read(addr uint64, n int) []byte {
+	for _, s := range img.f.Sections {
+		if s.Type != elf.SHT_PROGBITS || addr < s.Addr || addr+uint64(n) > s.Addr+s.Size {
+			continue
+		}
+		buf := make([]byte, n)
+		if _, err := s.ReadAt(buf, int64(addr-s.Addr)); err != nil && err != io.EOF {
+			return nil
+		}
+		return buf
+	}
+	return nil
+}
+
+// typeName reads the descriptor's reflection string (offset 24, a
+// pointer to a Go string), falling back to the symbol name.
+func (img *image) typeName(o *object) string {
+	if o.flags&flagSmallPage != 0 {
+		return "<small objects>"
+	}
+	if o.typ == 0 {
+		return "<untyped>"
+	}
+	if desc := img.read(uint64(o.typ), 36); desc != nil {
+		if str := img.read(uint64(binary.LittleEndian.Uint32(desc[24:])), 8); str != nil {
+			data := binary.LittleEndian.Uint32(str[0:])
+			n := binary.LittleEndian.Uint32(str[4:])
+			if n < 256 {
+				if name := img.read(uint64(data), int(n)); name != nil {
+					return string(name)
+				}
+			}
+		}
+	}
+	if s := lookup(img.objs, uint64(o.typ)); s != nil {
+		return s.name
+	}
+	return fmt.Sprintf("type@0x%08x", o.typ)
+}
+
+// rootName names a root slot: a global, or a stack or runtime word
+func (img *image) rootName(slot uint32) string {
+	if s := lookup(img.objs, uint64(slot)); s != nil {
+		if off := uint64(slot) - s.addr; off != 0 {
+			return fmt.Sprintf("%s+0x%x", s.name, off)
+		}
+		return s.name
+	}
+	return fmt.Sprintf("stack/runtime 0x%08x", slot)
+}
+
+type typeStats struct {
+	name            string
+	count           int
+	bytes, retained uint64
+}
+
+// where notes objects outside the semispace
+func where(o *object) string {
+	switch {
+	case o.flags&flagPinned != 0:
+		return ", pinned/large"
+	case o.flags&flagNursery != 0:
+		return ", nursery"
+	case o.flags&flagMature != 0:
+		return ", mature"
+	}
+	return ""
+}
+
+func main() {
+	top := flag.Int("top", 20, "types to show (0 = all)")
+	paths := flag.Int("paths", 10, "largest retainers to show with dominator paths")
+	flag.Usage = func() {
+		fmt.Fprintln(os.Stderr, "usage: heapsnap [-top n] [-paths n] game.elf heap.snap")
+		flag.PrintDefaults()
+	}
+	flag.Parse()
+	if flag.NArg() != 2 {
+		flag.Usage()
+		os.Exit(2)
+	}
+
+	img, err := openImage(flag.Arg(0))
+	if err != nil {
+		fmt.Fprintln(os.Stderr, "heapsnap:", err)
+		os.Exit(1)
+	}
+	s, err := readSnapshot(flag.Arg(1))
+	if err != nil {
+		fmt.Fprintln(os.Stderr, "heapsnap:", err)
+		os.Exit(1)
+	}
+	sort.Slice(s.objects, func(i, j int) bool { return s.objects[i].addr < s.objects[j].addr })
+
+	g := buildGraph(s)
+	idom, rpo := dominators(g)
+
+	// Retained size: children before parents (reverse of rpo)
+	retained := make([]uint64, len(g.succ))
+	for i, o := range s.objects {
+		retained[i+1] = uint64(o.size)
+	}
+	for i := len(rpo) - 1; i > 0; i-- {
+		retained[idom[rpo[i]]] += retained[rpo[i]]
+	}
+
+	names := make([]string, len(g.succ))
+	var total, unreachable uint64
+	for i := range s.objects {
+		names[i+1] = img.typeName(&s.objects[i])
+		total += uint64(s.objects[i].size)
+		if idom[i+1] < 0 {
+			unreachable += uint64(s.objects[i].size)
+		}
+	}
+
+	// A type retains what its outermost objects retain: skip objects
+	// dominated by another object of the same type (list and tree nodes)
+	stats := map[string]*typeStats{}
+	for _, n := range rpo[1:] {
+		st := stats[names[n]]
+		if st == nil {
+			st = &typeStats{name: names[n]}
+			stats[names[n]] = st
+		}
+		st.count++
+		st.bytes += uint64(s.objects[n-1].size)
+		outer := true
+		for d := idom[n]; d != 0; d = idom[d] {
+			if names[d] == names[n] {
+				outer = false
+				break
+			}
+		}
+		if outer {
+			st.retained += retained[n]
+		}
+	}
+	var byType []*typeStats
+	for _, st := range stats {
+		byType = append(byType, st)
+	}
+	sort.Slice(byType, func(i, j int) bool { return byType[i].retained > byType[j].retained })
+
+	fmt.Printf("%d objects, %d bytes (%d unreachable), %d roots, after GC #%d\n",
+		len(s.objects), total, unreachable, len(s.roots), s.gcCount)
+	fmt.Printf("heap in use %d bytes, semispace %d bytes\n", s.inUse, s.spaceSize)
+	fmt.Printf("%12s %6s %12s %8s  %s\n", "retained", "%", "shallow", "objects", "type")
+	for i, st := range byType {
+		if *top > 0 && i == *top {
+			break
+		}
+		fmt.Printf("%12d %5.1f%% %12d %8d  %s\n", st.retained,
+			100*float64(st.retained)/float64(total), st.bytes, st.count, st.name)
+	}
+
+	// Largest retainers that are not inside another large retainer's
+	// report: each object's path runs through its dominators to a root
+	nodes := append([]int(nil), rpo[1:]...)
+	sort.Slice(nodes, func(i, j int) bool { return retained[nodes[i]] > retained[nodes[j]] })
+	shown := map[int]bool{}
+	fmt.Println()
+	for _, n := range nodes {
+		if len(shown) == *paths {
+			break
+		}
+		var chain []int
+		inside := false
+		for d := n; d != 0; d = idom[d] {
+			chain = append(chain, d)
+			inside = inside || shown[d]
+		}
+		if inside {
+			continue // A dominator shown above already accounts for it
+		}
+		shown[n] = true
+
+		o := &s.objects[n-1]
+		fmt.Printf("%d bytes retained by %s @0x%08x\n", retained[n], names[n], o.addr)
+		first := chain[len(chain)-1]
+		if slot, ok := g.rootSlot[first]; ok {
+			fmt.Printf("    root %s\n", img.rootName(slot))
+		} else {
+			fmt.Printf("    root <several>\n")
+		}
+		for i := len(chain) - 1; i >= 0; i-- {
+			d := chain[i]
+			fmt.Printf("    -> %s @0x%08x (%d bytes%s)\n", names[d], s.objects[d-1].addr,
+				s.objects[d-1].size, where(&s.objects[d-1]))
+		}
+	}
+}